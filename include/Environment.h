@@ -125,7 +125,7 @@ class Environment {
    *
    * @return A list of Integers with halting vehicles.
    */
-  std::vector<int> getHaltingNumbers();
+  std::vector<int> getHaltingNumbers() const;
 
   /** @brief Get the vehicles.
    *
@@ -6,6 +6,9 @@
  */
 class ISimulationObject {
  public:
+  /// @brief Simulation components are released through the interface, see Simulation::~Simulation.
+  virtual ~ISimulationObject() = default;
+
   /// @brief Simulation Step Method, called in Simulation Class.
   virtual void step() {};
 };
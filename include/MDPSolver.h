@@ -0,0 +1,103 @@
+#ifndef INCLUDE_MDPSOLVER_H_
+#define INCLUDE_MDPSOLVER_H_
+
+#include <vector>
+
+#include "Strategy.h"
+
+class Environment;
+class Controller;
+struct ExplicitModel;
+
+/** @class MDPSolver
+ * Native explicit state engine for the shield model, an alternative to STORM.
+ *
+ * @details The MDP has the fixed shape of the generated PRISM model (arbiter x controller x lane counters)
+ * and gets built directly from the Environment and Controller instance. The three moves of the arbiter
+ * (environment, controller, shield) are folded into one step per shield decision, which keeps the
+ * optimal choices of the long run average reward (Rmin=? [ LRA ]). The MDP is solved by relative value iteration.
+ * The values of the last solve are kept to warm start the next generation.
+ *
+ * With --symmetry-reduction lanes with the same probability, size and ways are interchangeable.
+ * Permuting their counters changes neither the rewards nor the transitions, so the solver works on
+ * the quotient model with one representative per orbit (the counters of each lane class sorted) and
+ * expands the choices to the full strategy table. The reduction is exact, without interchangeable
+ * lanes every class has one lane and the quotient is the full model.
+ */
+class MDPSolver {
+ private:
+  /// Values of the last solve, indexed by (model state * actions + action).
+  std::vector<double> values;
+  std::vector<int> valuesStateSpace;
+  size_t valuesActionCount{0};
+  /// Lane classes and sorted lane state indices of the model states of the last solve, no states if it was not reduced.
+  std::vector<std::vector<size_t>> valuesClasses;
+  std::vector<size_t> valuesStates;
+  /// Number of model states of the last solve.
+  size_t modelStates{0};
+
+ public:
+  MDPSolver() = default;
+
+  /** @brief Solve the shield model of the environment and controller.
+   *
+   * @param environment A environment object with the state space and lane probabilities.
+   * @param controller A controller object with the phase probabilities and ways.
+   * @param table A strategy table filled by the method, state order follows the environment labels.
+   * @return True if a strategy is found, False if the model exceeds the solver limits
+   * (states, --synthesis-memory or --synthesis-timeout).
+   */
+  bool solve(const Environment &environment, const Controller &controller, StrategyTable &table);
+
+  /** @brief Solve the shield model of the parameters of the explicit export.
+   * The solver does not touch the Environment and Controller instance, the job pool runs it on a worker thread.
+   *
+   * @param model A ExplicitModel from ShieldModelGenerator::getExplicitModel.
+   * @param table A strategy table filled by the method, state order follows the labels of the model.
+   * @return True if a strategy is found, False if the model exceeds the solver limits.
+   */
+  bool solve(const struct ExplicitModel &model, StrategyTable &table);
+
+  /** @brief Get the size of the last solved model.
+   *
+   * @return A Integer with the number of states (as ShieldModelGenerator::getModelSize counts them),
+   * smaller than the predicted number if the model got reduced.
+   */
+  size_t getModelStates() const;
+
+  /** @brief Get the classes of interchangeable lanes.
+   * Lanes are interchangeable if they have the same probability, the same size and belong to the same ways.
+   *
+   * @param stateSpace A list of Integers with the state space size.
+   * @param laneProbabilities A list of Floats with the (quantized) lane probabilities.
+   * @param wayLanes A list of lane index lists, one per action.
+   * @return A list of lane index lists, ordered by their first lane.
+   */
+  static std::vector<std::vector<size_t>> getLaneClasses(const std::vector<int> &stateSpace,
+                                                         const std::vector<float> &laneProbabilities,
+                                                         const std::vector<std::vector<size_t>> &wayLanes);
+
+ private:
+  /** @brief Map a lane state to the representative of its orbit, the counters of each class get sorted.
+   *
+   * @param state A list of Integers with the lane state, sorted in place.
+   * @param classes A list of lane classes.
+   * @param stateSpace A list of Integers with the state space size.
+   * @return A Integer with the lane state index (mixed radix) of the representative.
+   */
+  static size_t canonicalize(std::vector<int> &state, const std::vector<std::vector<size_t>> &classes,
+                             const std::vector<int> &stateSpace);
+
+  /** @brief Get the warm start values for a new state space.
+   * Values of lane states outside the old state space are taken from the clipped state.
+   *
+   * @param stateSpace A list of Integers with the new state space size.
+   * @param actionCount A Integer with the number of actions.
+   * @param coords A list of Integers with the lane states of the model states.
+   * @return A list of values, zeros if there is no previous solve with the same dimension.
+   */
+  std::vector<double> getInitialValues(const std::vector<int> &stateSpace, size_t actionCount,
+                                       const std::vector<int> &coords) const;
+};
+
+#endif //INCLUDE_MDPSOLVER_H_
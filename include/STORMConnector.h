@@ -3,26 +3,121 @@
 
 #include <iostream>
 #include <map>
+#include <deque>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <sys/resource.h>
+
+#include "MDPSolver.h"
+#include "ShieldModelGenerator.h"
+#include "Strategy.h"
+#include "SynthesisTelemetry.h"
 
 class Shield;
 
 /**
- * Struct STORMJob. Contains information of a running STORM process.
+ * Struct STORMModel. Contains the generated model handed over to STORM.
+ */
+struct STORMModel {
+  /// Content address of the model.
+  std::string key;
+  /// PRISM program, parametric if there are constants.
+  std::string prism;
+  /// Values of the undefined constants of a parametric PRISM program (STORM --constants), empty otherwise.
+  std::string constants;
+  /// PRISM properties, separated by ';'.
+  std::string properties;
+  /// Lane labels of the state variables, the order of the values in the strategy table.
+  std::vector<std::string> labels;
+  /// Parameters for the explicit DRN export, no labels if STORM parses the PRISM program.
+  struct ExplicitModel explicitModel;
+  /// Predicted number of states.
+  size_t states{0};
+  /// Name of the external synthesis backend (SynthesisBackend::create), empty for the default STORM engine.
+  std::string backend;
+};
+
+/**
+ * Struct NativeSolution. Contains the result of a in-process solve on a worker thread.
+ */
+struct NativeSolution {
+  bool solved{false};
+  StrategyTable table;
+  /// CPU time of the worker thread in seconds and the number of solved model states.
+  double cpuTime{0.};
+  size_t states{0};
+};
+
+/**
+ * Struct STORMJob. Contains information of a queued or running STORM process.
  */
 struct STORMJob {
-  pid_t pid;
-  clock_t start;
-  //clock_t end;
-  //int exit;
+  /// pid of the STORM process, -1 while the job is queued, 0 if the job runs in a synthesis worker or on a thread.
+  pid_t pid{-1};
+  /// Process file descriptor to wait on the job without busy polling, -1 if not supported.
+  int pidfd{-1};
+  /// Wall clock start of the STORM process, the process gets killed after the deadline.
+  std::chrono::steady_clock::time_point start;
+  std::chrono::steady_clock::time_point deadline;
+  /// Wall clock exit of the STORM process, stamped when a wait sees the process file descriptor (or the
+  /// connection) readable, otherwise when the job gets collected. Unset (epoch) while the job runs.
+  std::chrono::steady_clock::time_point end;
+  /// File prefix of the out/ files the job got started with, a regular job taking a speculative job over keeps it.
+  std::string filePrefix;
+  /// Model of the shield which owns the job.
+  struct STORMModel model;
+  /// In-memory files of the model, the exported scheduler and the output of STORM, -1 if files are used.
+  int modelFd{-1};
+  int schedFd{-1};
+  int logFd{-1};
+  /// Connection to the synthesis worker running the job and its response, -1 if STORM runs locally.
+  int socketFd{-1};
+  std::string response;
+  /// Solver of the shield owning a job of a in-process backend, nullptr for STORM jobs.
+  std::shared_ptr<MDPSolver> solver;
+  /// Solve on the worker thread and the event file descriptor it signals when it finished, -1 if not supported.
+  std::future<struct NativeSolution> solution;
+  int eventFd{-1};
+  /// Resource usage of the finished process and if it got killed after the deadline.
+  struct rusage usage{};
+  bool timedOut{false};
+  /// Further shields with the same model, they get the strategy of the owner.
+  std::vector<Shield *> subscribers;
+  /// Shield which requested a speculative job, nullptr for regular jobs.
+  Shield *requester{nullptr};
+  /// Shields which requested the model speculatively before a regular job took the speculative job over,
+  /// they get the strategy as speculation.
+  std::vector<Shield *> speculativeSubscribers;
 };
 
 /** @class STORMConnector
  * Singleton which starts STORM processes and keeps track of them.
+ *
+ * @details The connector works as a job pool. A bounded number of STORM processes
+ * run concurrently, further jobs are queued. Finished jobs are collected without
+ * blocking by calling poll() from the simulation step loop. Each process has a wall clock deadline
+ * and an optional memory limit, processes exceeding the deadline get killed.
+ * Shields with the same model key share one job, STORM runs once per distinct model.
+ * Speculative jobs use the idle slots of the pool and give way to regular jobs.
+ * With --synthd the jobs are sent to a synthesis worker (adaptiveShielding-synthd) instead of
+ * starting STORM, the connector is the client of the worker then (see SynthesisProtocol.h).
+ * Jobs of a in-process backend (native) take a slot as well and run the MDPSolver of the owner
+ * on a worker thread, the solver enforces the time limit itself.
  */
 class STORMConnector {
  private:
-  // Every instance should have max. one active job.
+  // Every instance should have max. one active job, the key is the shield owning the model.
   std::map<Shield *, struct STORMJob> jobs;
+  // Jobs waiting for a free slot in the pool.
+  std::deque<Shield *> pendingJobs;
+  // Speculative jobs by model key, they only run while no regular job waits.
+  std::map<std::string, struct STORMJob> speculativeJobs;
+  std::deque<std::string> pendingSpeculativeJobs;
+  // Measured states per second of STORM, exponential average of the finished jobs.
+  double throughput{0.};
 
  public:
   /// @brief Get the Singleton instance
@@ -34,12 +129,133 @@ class STORMConnector {
   ~STORMConnector() = default;
 
   /** @brief Start a Strategy Update.
-   * This method forks STORM, waits until it is finished and
-   * triggers the loading of the new strategy.
+   * This method queues the STORM job of the shield and starts it as soon as the pool has a free slot.
+   * If another shield has a job for the same model, the shield subscribes to this job instead.
+   * The method does not block, the new strategy gets loaded by poll() or waitForStrategyUpdate().
+   *
+   * @param shield A reference to the Shield instance.
+   * @param model The generated model with its key.
+   */
+  void startStrategyUpdate(Shield *shield, const struct STORMModel &model);
+
+  /** @brief Check if the shield has a queued or running job, or subscribed to one.
+   *
+   * @param shield A reference to the Shield instance.
+   * @return True if there is a job, False otherwise.
+   */
+  bool hasStrategyUpdate(Shield *shield) const;
+
+  /** @brief Check if the STORM process of the shield is running.
+   *
+   * @param shield A reference to the Shield instance.
+   * @return True if STORM is running for the shield, False otherwise.
+   */
+  bool isRunning(Shield *shield) const;
+
+  /// @brief Collect finished jobs, triggers the callbacks and starts queued jobs. NON-BLOCKING.
+  void poll();
+
+  /** @brief Wait until the job of the shield is finished. BLOCKING.
+   * Other jobs finishing in the meantime are handled as well.
+   *
+   * @param shield A reference to the Shield instance.
+   */
+  void waitForStrategyUpdate(Shield *shield);
+
+  /// @brief Wait until all queued and running jobs are finished. BLOCKING.
+  void waitForAllStrategyUpdates();
+
+  /** @brief Start a speculative Strategy Update with low priority.
+   * The job only starts if no regular job waits for a free slot and gets killed if a regular job
+   * needs the slot. A regular job for the same model takes the speculative job over.
+   * The strategy is handed over by Shield::shareSpeculativeStrategyCallback,
+   * a failed job is reported by Shield::shareSpeculativeFailureCallback.
    *
    * @param shield A reference to the Shield instance.
+   * @param model The generated model with its key.
+   */
+  void startSpeculativeUpdate(Shield *shield, const struct STORMModel &model);
+
+  /** @brief Remove the shield from a speculative job, the job gets removed if no other shield waits for it.
+   *
+   * @param shield A reference to the Shield instance.
+   * @param modelKey A String with the key of the speculative model.
+   */
+  void cancelSpeculativeUpdate(Shield *shield, const std::string &modelKey);
+
+  /** @brief Remove the shield from all speculative jobs.
+   *
+   * @param shield A reference to the Shield instance.
+   */
+  void cancelSpeculativeUpdates(Shield *shield);
+
+  /** @brief Get the measured synthesis throughput.
+   *
+   * @return A Float with the states per second, 0 if no job finished yet.
+   */
+  double getThroughput() const;
+
+  /** @brief Remove a queued job or kill a running job of the shield.
+   * No callback will be triggered for the shield, subscribers of the job keep their update.
+   *
+   * @param shield A reference to the Shield instance.
+   */
+  void cancelStrategyUpdate(Shield *shield);
+
+  // The job methods are shared with the synthesis worker, which runs the STORM processes of its clients.
+
+  /** @brief Start the STORM process of a job and set its deadline.
+   * With --synthd the job is sent to the synthesis worker, STORM is started locally if the worker
+   * is not reachable. A job with a solver runs it on a worker thread instead.
+   *
+   * @param filePrefix A String with the file prefix of the PRISM files.
+   * @param job The queued job.
+   * @return True if STORM is started, False otherwise.
+   */
+  static bool startJob(const std::string &filePrefix, struct STORMJob &job);
+
+  /** @brief Collect the STORM process of a job, kill it if the deadline passed.
+   *
+   * @param filePrefix A String with the file prefix of the PRISM files.
+   * @param job The running job.
+   * @param waitStatus The exit status of the process.
+   * @return The pid (1 for jobs of the synthesis worker or a thread) if the job finished, 0 if it is still running,
+   * -1 on error.
+   */
+  static pid_t collectJob(const std::string &filePrefix, struct STORMJob &job, int &waitStatus);
+
+  /** @brief Stamp the exit time of a job, the first stamp is kept.
+   * Waits call it when the process file descriptor (or the connection) of the job became readable.
+   *
+   * @param job The running job.
+   */
+  static void stampExit(struct STORMJob &job);
+
+  /// @brief Kill the STORM process of a job (or close the connection to the worker) and release its file descriptors.
+  /// A solve on a worker thread can not be killed, the method waits for it.
+  static void killJob(struct STORMJob &job);
+
+  /** @brief Measure a finished job and load the strategy table.
+   * Releases the file descriptors and the connection of the job.
+   *
+   * @param filePrefix A String with the file prefix of the PRISM files.
+   * @param job The finished job.
+   * @param waitStatus The exit status of the process.
+   * @param record The measurements filled by the method.
+   * @param table The strategy table filled by the method.
+   * @return True if the synthesis succeeded, False otherwise.
+   */
+  static bool finishJob(const std::string &filePrefix, struct STORMJob &job, int waitStatus,
+                        struct SynthesisRecord &record, StrategyTable &table);
+
+  /** @brief Parse the scheduler STORM exported for a model.
+   *
+   * @param sched A String with the content of the scheduler.
+   * @param model The model STORM solved.
+   * @param table The strategy table filled by the method, states follow the labels of the model.
+   * @return A Boolean, True if the scheduler is parsed, False if it is malformed.
    */
-  void startStrategyUpdate(Shield *update);
+  static bool parseScheduler(const std::string &sched, const struct STORMModel &model, StrategyTable &table);
 
  private:
   /// Hide from user.
@@ -47,19 +263,126 @@ class STORMConnector {
   STORMConnector(const STORMConnector &) = delete;
   STORMConnector &operator=(const STORMConnector &) = delete;
 
-  /** @brief Static methods forks STORM with arguments and return the pid.
+  /** @brief Static methods starts STORM with arguments (spawnProcess) and return the pid.
+   *
+   * @details The model (PRISM program or explicit DRN model) is handed over by a memfd and STORM
+   * writes the scheduler into a memfd, both are passed as /dev/fd paths. No file in out/ is touched.
+   * If memfds are not supported, the job falls back to the out/ files.
+   * A parametric PRISM program is written once (getTemplateFile), the values come by --constants.
    *
    * @param filePrefix A String with the file prefix of the PRISM files.
-   * @return A pid of the forked STORM process.
+   * @param job The job with the model, the method sets the file descriptors.
+   * @return A pid of the STORM process, -1 on error.
    */
-  static pid_t startStorm(std::string &filePrefix);
+  static pid_t startStorm(const std::string &filePrefix, struct STORMJob &job);
+
+  /** @brief Write the model of the job in the format STORM gets started with.
+   *
+   * @param out A stream the model gets written to.
+   * @param model The model of the job.
+   */
+  static void writeModel(std::ostream &out, const struct STORMModel &model);
+
+  /** @brief Get the in-memory file of a parametric PRISM program.
+   * The file is written once and shared by the jobs with the same program.
+   *
+   * @param program A String with the parametric PRISM program.
+   * @return A file descriptor, -1 if memfds are not supported.
+   */
+  static int getTemplateFile(const std::string &program);
+
+  /** @brief Read the scheduler STORM exported for the job and release the file descriptors.
+   *
+   * @param job The finished job, the out/ files follow the file prefix it got started with.
+   * @return A String with the content of the scheduler.
+   */
+  static std::string readScheduler(struct STORMJob &job);
+
+  /** @brief Read the output of STORM, append it to STORM.log and measure the job.
+   *
+   * @param job The finished job.
+   * @param waitStatus The exit status of the process.
+   * @return A SynthesisRecord with the measurements, model size and outcome.
+   */
+  static struct SynthesisRecord measureJob(struct STORMJob &job, int waitStatus);
+
+  /** @brief Read an in-memory file from the start.
+   *
+   * @param fd A Integer with the file descriptor.
+   * @return A String with the content.
+   */
+  static std::string readFile(int fd);
+
+  /// @brief Close the in-memory files of the job.
+  static void closeFiles(struct STORMJob &job);
+
+  /** @brief Send the job to the synthesis worker (--synthd).
+   *
+   * @param job The queued job.
+   * @return True if the worker accepted the request, False otherwise.
+   */
+  static bool sendJob(struct STORMJob &job);
+
+  /** @brief Check if a backend solves in-process.
+   *
+   * @param backend A String with the name of the backend (SynthesisBackend::create).
+   * @return True if the backend runs in-process, False otherwise or for unknown backends.
+   */
+  static bool isInProcess(const std::string &backend);
+
+  /// @brief Start queued jobs until the pool is full, speculative jobs only if no regular job waits.
+  /// Regular jobs are started by priority (Shield::getSynthesisPriority).
+  void dispatch();
+
+  /** @brief Get the priority of a queued job, the max. priority of the owner and the subscribers.
+   *
+   * @param shield A reference to the Shield instance owning the job.
+   * @return A Float with the priority.
+   */
+  float getPriority(Shield *shield) const;
+
+  /** @brief Get the file prefix of a speculative job.
+   *
+   * @param modelKey A String with the key of the speculative model.
+   * @return A String with the junction of the requester and the model key.
+   */
+  std::string getSpeculativePrefix(const std::string &modelKey);
+
+  /** @brief Get the shield owning the job the shield subscribed to.
+   *
+   * @param shield A reference to the Shield instance.
+   * @return A reference to the owner, nullptr if the shield is no subscriber.
+   */
+  Shield *findOwner(Shield *shield) const;
+
+  /** @brief Move the subscribers of a job to a new queued job of the first subscriber.
+   * The subscribers have the same model, any of them can own the job.
+   * Without subscribers the speculative subscribers get a speculative job again.
+   *
+   * @param job The job which gets removed.
+   */
+  void promoteSubscribers(struct STORMJob &job);
+
+  /** @brief Sleep until a running job may have changed its state.
+   *
+   * @param timeout A Integer with the max. waiting time in ms.
+   */
+  void waitForAnyJob(int timeout);
 
   /** @brief This method checks on the STORM job of the shield.
+   *
+   * STORM gets killed if the job exceeds its deadline, the shield keeps the old strategy.
    *
    * @param shield A reference to the Shield instance.
    * @return A Integer with the status (running==-1, succeeded==0, error==1).
    */
   int checkOnStorm(Shield *shield);
+
+  /** @brief This method checks on a speculative STORM job, failed jobs are dropped silently.
+   *
+   * @param modelKey A String with the key of the speculative model.
+   */
+  void checkOnSpeculativeStorm(const std::string &modelKey);
 };
 
 #endif //INCLUDE_STORMCONNECTOR_H_
@@ -1,16 +1,32 @@
 #ifndef INCLUDE_SHIELD_H_
 #define INCLUDE_SHIELD_H_
 
+#include <map>
+#include <memory>
 #include <vector>
 #include <string>
 
 #include "Environment.h"
 #include "Controller.h"
 #include "Strategy.h"
+#include "MDPSolver.h"
 
 #include "ShieldConfig.h"
 #include "ShieldModelGenerator.h"
 
+struct STORMModel;
+
+/**
+ * Struct Speculation. Contains a speculative strategy for the next state space size.
+ */
+struct Speculation {
+  std::vector<int> stateSpace;
+  /// Quantized probabilities of the environment when the speculation started.
+  std::vector<float> probabilities;
+  bool solved{false};
+  StrategyTable table;
+};
+
 /** @class Shield
  * Keeps track of Controller and Environment and holds the Shield Strategy.
  * Creates the PRISM Files for the STORM Model Checker.
@@ -23,17 +39,35 @@ class Shield : public ShieldConfig, ShieldModelGenerator {
   Controller controller;
   Environment environment;
   Strategy strategy;
+  /// In-process synthesis (--synthesis-backend native), keeps the values for warm starts.
+  /// Shared with the job pool, which runs it on a worker thread.
+  std::shared_ptr<MDPSolver> solver{std::make_shared<MDPSolver>()};
 
   /// Keep track of states in case of roll back
   /// Implement momento pattern in multithreading applications.
   std::vector<float> lastEnvironmentProbabilities;
   std::vector<int> lastStateSpace;
   std::vector<int> newStateSpace;
-  bool maxStateSpaceSizeReached{false};
+
+  /// Back off the state space growth after failed syntheses.
+  std::vector<int> failedStateSpace;
+  int backoffLength{0};
+  int backoff{0};
+
+  /// Speculative strategies by model key.
+  std::map<std::string, struct Speculation> speculations;
 
   /// Log the state space history to adapt state space values.
   std::vector<std::vector<int>> stateSpaceHistory;
 
+  /// Updates since the last installed strategy.
+  int strategyAge{0};
+
+  /// Sub-shields of the lane groups (--sub-shield-lanes), empty if the shield synthesizes the whole junction.
+  std::vector<std::unique_ptr<Shield>> subShields;
+  /// Lane indices of the sub-shields in the environment of this shield.
+  std::vector<std::vector<size_t>> laneGroups;
+
   /// Log some properties.
   int generation{-1};
   int stateDelta{0};
@@ -55,6 +89,10 @@ class Shield : public ShieldConfig, ShieldModelGenerator {
    */
   Shield(const std::string &junction, const Environment &environment, const Controller &controller);
 
+  /// The job pool and the sub-shields refer to a shield by its address, a shield can not be copied.
+  Shield(const Shield &) = delete;
+  Shield &operator=(const Shield &) = delete;
+
   /** @brief Get Shield state.
    *
    * @return A Boolean, True if active, False otherwise.
@@ -88,6 +126,14 @@ class Shield : public ShieldConfig, ShieldModelGenerator {
   /// @brief Get the current shield generation.
   int getShieldGeneration() const;
 
+  /** @brief Get the urgency of a strategy synthesis for the shield.
+   * The priority weights the probability change, the state space growth, the halting vehicles beyond
+   * the state bounds of the strategy and the strategy age (see PRIORITY_WEIGHT_*).
+   *
+   * @return A Float with the priority, higher is more urgent. Max. priority without strategy.
+   */
+  float getSynthesisPriority() const;
+
   /// @brief Print shield properties of Traffic Light.
   void printConfig();
 
@@ -96,14 +142,32 @@ class Shield : public ShieldConfig, ShieldModelGenerator {
   /// which can cause troubles with test script
   std::string logConfig();
 
+  /// @brief Destructor for the Shield Class, cancels a pending STORM job.
+  ~Shield();
+
   /** @brief Creates a new Strategy with STORM Model Checker and overwrites the old.
    *
    * @details This method wraps the Singleton function call,
    * which triggers the fork of STORM with the generated PRISM files.
    * After STORM finished the Strategy gets updated.
-   * BLOCKING until STORM process finished!
+   * With the native backend the job pool runs the MDPSolver on a worker thread instead.
+   * If blocking is set, the method waits until the STORM process (or the solver) finished,
+   * otherwise the current Strategy stays in use until the job pool loads the new one.
+   *
+   * @param blocking A Boolean flag, wait for the STORM process if True.
+   * @return A Boolean, False if a running STORM job of this shield prevents the update.
    */
-  void createStrategy();
+  bool createStrategy(bool blocking = true);
+
+  /** @brief Install the cached strategy of the current model without synthesis (--lazy-shields).
+   * Without cached strategy the shield stays inactive until the first update after the warm up.
+   *
+   * @return A Boolean, True if the strategy (of all sub-shields) is loaded from the cache.
+   */
+  bool loadCachedStrategy();
+
+  /// @brief Get the in-process solver of the shield, jobs of the native backend run on it.
+  std::shared_ptr<MDPSolver> getSolver() const;
 
   /** @brief Get the reference of the current Strategy instance.
    *
@@ -113,13 +177,99 @@ class Shield : public ShieldConfig, ShieldModelGenerator {
 
   /** @brief Updates the reference to the Strategy instance.
    * This method will be called by the STORMConnector.
+   *
+   * @param table The strategy table of the scheduler exported by STORM.
+   * @param modelKey A String with the key of the solved model.
+   */
+  void updateStrategyCallback(const StrategyTable &table, const std::string &modelKey);
+
+  /** @brief Updates the Strategy with the table of a shield with the same model.
+   * This method will be called by the STORMConnector when the job was shared.
+   * The model key maps labels by position, the table follows the label vector of this Strategy.
+   *
+   * @param table A strategy table of the shield which owned the STORM job.
+   */
+  void shareStrategyCallback(const StrategyTable &table);
+
+  /** @brief Store the strategy of a speculative job.
+   * This method will be called by the STORMConnector for the requester and all shields with the same model.
+   *
+   * @param modelKey A String with the key of the speculative model.
+   * @param table The strategy table of the speculative job.
+   */
+  void shareSpeculativeStrategyCallback(const std::string &modelKey, const StrategyTable &table);
+
+  /** @brief Drop a speculation whose job failed, the next update may speculate on the model again.
+   * This method will be called by the STORMConnector for the requester and all shields with the same model.
+   *
+   * @param modelKey A String with the key of the speculative model.
+   */
+  void shareSpeculativeFailureCallback(const std::string &modelKey);
+
+ private:
+  /// @brief Export the new Strategy and count the generation.
+  void installStrategy();
+
+  /** @brief Generate the model for STORM.
+   * With --parametric-model the PRISM program of the junction is generated once, the model carries the constants.
+   *
+   * @param modelEnvironment The environment of the model, the shield environment or a speculative one.
+   * @return The model with its key and predicted size.
+   */
+  struct STORMModel getSTORMModel(const Environment &modelEnvironment);
+
+  /** @brief Synthesize strategies for the next state space sizes (each lane +1) in the background.
+   * The speculative jobs run at the current probabilities while the pool is idle.
+   */
+  void speculate();
+
+  /** @brief Update the shield on observations.
+   *
+   * @param blocking A Boolean flag, wait for the strategy synthesis if True.
+   */
+  void updateShield(bool blocking);
+
+  /** @brief Split the shield into sub-shields if the junction has more lanes than --sub-shield-lanes.
+   * The sub-shields get the lanes of a group and all phases, a phase serves only the lanes of the group.
+   *
+   * @return True if the shield has sub-shields, False otherwise.
+   */
+  bool split();
+
+  /** @brief Project the values of the junction lanes onto the lanes of a group.
+   *
+   * @param values A list of Integers with a value per lane of the junction.
+   * @param group A list with the lane indices of the group.
+   * @return A list of Integers with the values of the group lanes.
    */
-  void updateStrategyCallback();
+  static std::vector<int> project(const std::vector<int> &values, const std::vector<size_t> &group);
 
-  /** @brief Lock the state space size and avoid future growth.
+  /** @brief Combine the recommendations of the sub-shields.
+   * Each sub-shield votes for its action with the halting vehicles of its lanes (+1), the action with the
+   * most votes wins. Ties keep the current action, otherwise the lower phase wins.
+   *
+   * @param currentAction Current traffic light controller phase.
+   * @return new controller phase, -1 if no sub-shield has a strategy.
+   */
+  int getComposedAction(int currentAction);
+
+  /** @brief Install a speculative strategy for the current state space.
+   * The speculation is used if the probabilities changed less than UPDATE_PROBABILITY_DELTA.
+   *
+   * @return True if a speculative strategy is installed, False otherwise.
+   */
+  bool installSpeculation();
+
+ public:
+
+  /** @brief Fall back to the working state space and back off the state space growth.
    * The method wil be called when STORM timeouts or fails due to the complexity of the model.
+   *
+   * @details The old strategy stays active and the state space is reset to its size. The growth
+   * is blocked for a number of updates, which doubles with every failure in a row, afterwards the
+   * growth gets probed again. Without strategy the synthesis is retried with a smaller state space.
    */
-  void lockStateSpaceSize();
+  void synthesisFailureCallback();
 
   /** @brief Define needed state space from observations.
    *
@@ -130,7 +280,21 @@ class Shield : public ShieldConfig, ShieldModelGenerator {
    */
   std::vector<int> checkStateInfo();
 
-  /// @brief Update the state space size on observations.
+  /** @brief Get the state budget of the junction.
+   *
+   * @return A Integer with the max. number of model states from --state-budget and --time-budget, 0 if unlimited.
+   */
+  size_t getStateBudget() const;
+
+  /** @brief Fit the observed state space into the state budget.
+   *
+   * @param stateInfo A list of Integers with the state space from checkStateInfo.
+   * @param budget A Integer with the max. number of model states.
+   * @return A list of Integers with the state space, grown as far as the budget allows.
+   */
+  std::vector<int> fitStateBudget(const std::vector<int> &stateInfo, size_t budget) const;
+
+  /// @brief Update the state space size on observations, limited by the state budget.
   void updateStateSpace();
 
   /// @brief Update the state space probabilities on observations.
@@ -151,6 +315,21 @@ class Shield : public ShieldConfig, ShieldModelGenerator {
   /// @brief Update Shield properties on observations.
   void update();
 
+  /** @brief Partition the lanes into groups which share few phases.
+   *
+   * @details Two lanes interact if a phase serves both. Starting from single lanes, the groups
+   * with the most shared phases get merged as long as a group has at most maxLanes lanes.
+   * Lanes which share no phase stay in separate groups.
+   *
+   * @param labels A list of Strings with the lane labels.
+   * @param ways A list of lists of Strings with the lanes served by each phase.
+   * @param maxLanes A Integer with the max. number of lanes of a group.
+   * @return A list of lists with the lane indices of each group, sorted by the first lane.
+   */
+  static std::vector<std::vector<size_t>> getLaneGroups(const std::vector<std::string> &labels,
+                                                        const std::vector<std::vector<std::string>> &ways,
+                                                        size_t maxLanes);
+
   /** @brief Get the next action from the strategy, determined from current state space (= halting vehicle number)
    * and current traffic light controller phase.
    *
@@ -27,6 +27,9 @@ class ShieldConfig {
    */
   explicit ShieldConfig(const std::string &filename);
 
+  /// @brief Virtual, the configuration has virtual methods and Shield derives from it.
+  virtual ~ShieldConfig() = default;
+
   /** @brief Set filename.
   *
   * @param filename A String with shield configuration file name.
@@ -3,10 +3,34 @@
 
 #include <vector>
 #include <string>
+#include <ostream>
 
 class Environment;
 class Controller;
 
+/**
+ * Struct ExplicitModel. Contains the parameters of the shield model for the explicit (DRN) export.
+ */
+struct ExplicitModel {
+  std::vector<std::string> labels;
+  std::vector<int> stateSpace;
+  std::vector<float> laneProbabilities;
+  std::vector<std::string> actionLabels;
+  std::vector<float> actionProbabilities;
+  /// Lane positions of the way of each action.
+  std::vector<std::vector<size_t>> ways;
+};
+
+/**
+ * Struct ModelSize. Contains the predicted size of the shield model.
+ */
+struct ModelSize {
+  size_t states{0};
+  size_t choices{0};
+  /// Upper bound, STORM merges transitions of saturated lanes.
+  size_t transitions{0};
+};
+
 /** @class ShieldModelGenerator
  * Handles PRISM file generation.
  */
@@ -24,6 +48,10 @@ class ShieldModelGenerator {
   std::vector<std::string> module_shield;
   std::vector<std::string> module_rewards;
 
+  /// Parametric PRISM program (--parametric-model) and its lane labels, empty until it is generated.
+  std::string prismTemplate;
+  std::vector<std::string> prismTemplateLabels;
+
  public:
   ShieldModelGenerator() = default;
 
@@ -40,6 +68,87 @@ class ShieldModelGenerator {
   /// @brief Create PRISM file for STORM.
   void createPRISMFile(const Environment &environment, const Controller &controller);
 
+  /// @brief Create PRISM file for STORM from a generated PRISM program.
+  void createPRISMFile(const std::string &model);
+
+  /** @brief Get the PRISM program without file header (timestamp).
+   *
+   * @return A String with the PRISM program.
+   */
+  std::string getPRISMModel(const Environment &environment, const Controller &controller) const;
+
+  /** @brief Get the parametric PRISM program, the probabilities and lane sizes are undefined constants.
+   * The program gets generated once and is reused until the modules or the lane labels change.
+   *
+   * @return A String with the PRISM program.
+   */
+  const std::string &getPRISMTemplate(const Environment &environment, const Controller &controller);
+
+  /** @brief Get the values of the undefined constants of the parametric PRISM program.
+   *
+   * @return A String in the format of the STORM option --constants (name=value,...).
+   */
+  static std::string getPRISMConstants(const Environment &environment, const Controller &controller);
+
+  /** @brief Predict the size of the model before it gets generated.
+   * All states of the product are reachable, the size follows from the shape of the default modules.
+   *
+   * @param stateSpace A list of Integers with the state space size of the lanes.
+   * @param actionCount A Integer with the number of actions of the controller.
+   * @return A ModelSize with the number of states, choices and transitions.
+   */
+  static struct ModelSize getModelSize(const std::vector<int> &stateSpace, size_t actionCount);
+
+  /** @brief Get the parameters of the model for the explicit export.
+   *
+   * @return A ExplicitModel with the (quantized) probabilities of the environment and controller.
+   */
+  static struct ExplicitModel getExplicitModel(const Environment &environment, const Controller &controller);
+
+  /** @brief Write the model in the explicit DRN format of STORM.
+   *
+   * @details The generator enumerates the product state space itself and writes the states
+   * in index order to the stream, no transition is kept in memory. The model follows the
+   * default modules (arbiter, controller, environment, shield, rewards), modules loaded from
+   * a config file are only supported by the PRISM program (see hasDefaultModel).
+   * The state index is ((lanes*actions + action)*3 + move), the lanes are a mixed radix
+   * number with the first label as lowest digit. Choices of the shield move are labeled with
+   * the action labels.
+   *
+   * @param out A stream the model gets written to.
+   * @param model A ExplicitModel from getExplicitModel.
+   */
+  static void writeDRNModel(std::ostream &out, const struct ExplicitModel &model);
+
+  /// @brief Create DRN file for STORM.
+  void createDRNFile(const struct ExplicitModel &model);
+
+  /** @brief Get the properties for STORM.
+   *
+   * @return A String with the properties separated by ';'.
+   */
+  std::string getPropertiesString() const;
+
+  /** @brief Get the content address of the model (PRISM program and properties).
+   * Equal models result in equal keys and therefore in equal strategies.
+   * The lane labels are replaced by their position, by that junctions with the same
+   * structure share the key and the strategy table (ordered by label position).
+   *
+   * @param model A String with the PRISM program from getPRISMModel.
+   * @param labels A list of Strings with the lane labels in state order.
+   * @return A String with the hash of the model.
+   */
+  std::string getModelKey(const std::string &model, const std::vector<std::string> &labels) const;
+
+  /// @brief Set the default model: MDP, minimal long-run average reward and the generated modules.
+  void createDefaultModel(const Environment &environment, const Controller &controller);
+
+  /** @brief Check if the model is the default model, e.g. not changed by a config file.
+   *
+   * @return A Boolean, True if model type, properties and modules are the generated ones, False otherwise.
+   */
+  bool hasDefaultModel(const Environment &environment, const Controller &controller) const;
+
   /// @brief Create arbiter string for PRISM File.
   void createPRISMArbiter(const Controller &controller);
 
@@ -64,6 +173,15 @@ class ShieldModelGenerator {
   void setPRISMController(const std::vector<std::string> &module);
   void setPRISMShield(const std::vector<std::string> &module);
   void setPRISMRewards(const std::vector<std::string> &module);
+
+ private:
+  /** @brief Write the PRISM program.
+   *
+   * @param out A stream the program gets written to.
+   * @param parametric A Bool, True to leave the probabilities and lane sizes undefined.
+   */
+  void writePRISMModel(std::ostream &out, const Environment &environment, const Controller &controller,
+                       bool parametric) const;
 };
 
 #endif //INCLUDE_SHIELDMODELFILEGENERATOR_H_
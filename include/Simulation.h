@@ -54,6 +54,18 @@ class Simulation : public ISimulationObject {
              int xPos = -1,
              int yPos = -1);
 
+  /** @brief Synthesize the initial strategies of all traffic lights. BLOCKING.
+   * The syntheses are started together and run in parallel, the method returns after all of them finished.
+   * With --lazy-shields only cached strategies are loaded, the shields synthesize after the warm up.
+   * A traffic light which throws on its synthesis gets disabled, as a traffic light which fails to build.
+   */
+  void synthesizeStrategies();
+
+  /** @brief Spread the shield updates of the traffic lights evenly over the update interval.
+   * Every update interval the same number of shields synthesizes, instead of all shields in one time step.
+   */
+  void staggerUpdates();
+
   /// @brief Destructor for the Simulation Class.
   ~Simulation();
 
@@ -2,9 +2,147 @@
 #define INCLUDE_STRATEGY_H_
 
 #include <map>
+#include <iostream>
 #include <utility>
 #include <vector>
 #include <string>
+#include <cstdint>
+#include <unordered_map>
+
+/**
+ * Struct StrategyStep. Contains one mapping of a strategy table.
+ */
+struct StrategyStep {
+  std::vector<int> state;
+  int currentAction;
+  int nextAction;
+};
+
+/** @class StrategyTable
+ * Maps <current state space, current action> to the shield action.
+ *
+ * @details The states of a shield model form a hyper-rectangle (state space x actions), the table is a
+ * flat array indexed by the mixed radix number of the state and action (first lane is the highest digit,
+ * the action the lowest, by that the index order is the lexicographic order of the mappings).
+ * Missing mappings hold a sentinel. If the rectangle exceeds STRATEGY_TABLE_DENSE_MAX entries,
+ * the table falls back to a hash table of the mappings.
+ * The layout grows geometrically if a mapping exceeds it (the bounds can exceed the max. state values
+ * of the mappings), producers which know the state space set it upfront.
+ */
+class StrategyTable {
+ private:
+  /// Hash of a state with the action appended.
+  struct StateHash {
+    size_t operator()(const std::vector<int> &key) const;
+  };
+
+  /// Max. state values and number of actions of the layout.
+  std::vector<int> bounds;
+  int actionCount{0};
+  /// Stride of each lane in the dense index, the action has stride 1.
+  std::vector<size_t> strides;
+  /// Next action + 1 by index, 0 if there is no mapping.
+  std::vector<uint16_t> dense;
+  std::unordered_map<std::vector<int>, int, StateHash> sparse;
+  bool isSparse{false};
+  size_t count{0};
+  /// Max. state values of the mappings.
+  std::vector<int> stateSpace;
+
+ public:
+  StrategyTable() = default;
+
+  /** @brief Create a empty table with the layout of a model.
+   *
+   * @param stateSpace A list of Integers with the max. state values.
+   * @param actionCount A Integer with the number of actions.
+   */
+  StrategyTable(const std::vector<int> &stateSpace, int actionCount);
+
+  /** @brief Create a table from a list of mappings, the layout is fitted to the mappings.
+   *
+   * @param steps A list of mappings.
+   */
+  explicit StrategyTable(const std::vector<struct StrategyStep> &steps);
+
+  /** @brief Set the mapping of a state and action, the layout grows if the state exceeds it.
+   *
+   * @param state A list of Integer with state values.
+   * @param currentAction A Integer with the current action/phase index.
+   * @param nextAction A Integer with th next action/phase index.
+   */
+  void set(const std::vector<int> &state, int currentAction, int nextAction);
+
+  /** @brief Get the mapping of a state and action.
+   *
+   * @param state A list of Integer with state values.
+   * @param currentAction A Integer with the current action/phase index.
+   * @return A Integer with the next action, -1 if there is no mapping.
+   */
+  int get(const std::vector<int> &state, int currentAction) const noexcept;
+
+  /// @brief Get the number of mappings.
+  size_t size() const;
+
+  /// @brief Check if the table has no mapping.
+  bool empty() const;
+
+  /// @brief Remove all mappings and the layout.
+  void clear();
+
+  /** @brief Get the max. state values of the mappings.
+   *
+   * @return A list of Integer with the max. state values, empty if there is no mapping.
+   */
+  const std::vector<int> &getStateSpace() const;
+
+  /** @brief Get the number of actions of the dense layout.
+   *
+   * @return A Integer with the number of actions, 0 if the table falls back to the hash table.
+   */
+  int getActionCount() const;
+
+  /// @brief Get the max. state values of the dense layout, empty if the table falls back to the hash table.
+  const std::vector<int> &getBounds() const;
+
+  /// @brief Get the dense entries (next action + 1, 0 if there is no mapping) in index order.
+  const std::vector<uint16_t> &getEntries() const;
+
+  /** @brief Replace the table by a dense layout and its entries, e.g. of a binary strategy file.
+   *
+   * @param newBounds A list of Integers with the max. state values.
+   * @param newActionCount A Integer with the number of actions.
+   * @param entries The entries in index order (see getEntries), moved into the table, one per index of the layout.
+   * @param mappings A Integer with the number of entries with a mapping.
+   * @param maxState A list of Integers with the max. state values of the mappings.
+   * @return A Boolean, True if the entries fit a dense layout, False otherwise (the table is unchanged).
+   */
+  bool assignDense(const std::vector<int> &newBounds, int newActionCount, std::vector<uint16_t> &&entries,
+                   size_t mappings, const std::vector<int> &maxState);
+
+  /** @brief Get the mappings in lexicographic order of (state, current action).
+   *
+   * @return A list of mappings.
+   */
+  std::vector<struct StrategyStep> getSteps() const;
+
+ private:
+  /** @brief Set the layout, existing mappings are moved to the new layout.
+   *
+   * @param newBounds A list of Integers with the max. state values.
+   * @param newActionCount A Integer with the number of actions.
+   */
+  void layout(const std::vector<int> &newBounds, int newActionCount);
+
+  /// @brief Get the number of dense entries of a layout, larger than STRATEGY_TABLE_DENSE_MAX if it is too large.
+  static size_t layoutSize(const std::vector<int> &newBounds, int newActionCount);
+
+  /// @brief Check if the state and action are inside the layout.
+  bool contains(const std::vector<int> &state, int currentAction) const noexcept;
+
+  /// @brief Get the dense index of a state and action inside the layout.
+  size_t index(const std::vector<int> &state, int currentAction) const noexcept;
+};
 
 /** @class Strategy
  * Contains the Shield Strategy of the Model Checker.
@@ -16,8 +154,15 @@ class Strategy {
   std::vector<std::string> labels;
   std::string filePrefix;
 
-  /// Map <current state space, current action> to the shield action.
-  std::map<std::pair<std::vector<int>, int>, int> strategy_;
+  StrategyTable strategy_;
+  /// Next actions of the states without mapping, filled on their first miss, see resolveFallback.
+  StrategyTable fallbacks_;
+  bool resolved{false};
+  /// Lookups without mapping, resolved by a fallback or without action.
+  size_t misses{0};
+  size_t unresolved{0};
+  static size_t totalMisses;
+  static size_t totalUnresolved;
 
  public:
   Strategy() = default;
@@ -47,24 +192,113 @@ class Strategy {
   /** @brief Get the Strategy action on the simulation state (state,action).
    *
    * @param simulationState A pair of a state list and action.
-   * @return A Integer with the next action according to the Strategy.
+   * @return A Integer with the next action according to the Strategy, -1 if there is none.
    */
-  int getStrategyAction(std::pair<std::vector<int>, int> simulationState);
+  int getStrategyAction(const std::pair<std::vector<int>, int> &simulationState) noexcept;
 
   /** @brief Get the Strategy action on the current state and action of the simulation.
    *
    * @param state A list of Integer with state values.
    * @param currentAction A Integer with the current action/phase index.
-   * @return A Integer with the next action according to the Strategy.
+   * @details States without mapping use the mapping of the nearest covered state
+   * (the first lane decremented by one with a mapping), the fallbacks of the covered state space
+   * are remembered on their first miss.
+   * @return A Integer with the next action according to the Strategy, -1 if there is none.
+   */
+  int getStrategyAction(const std::vector<int> &state, int currentAction) noexcept;
+
+  /// @brief Get the number of lookups of states without mapping.
+  size_t getMisses() const;
+
+  /// @brief Get the number of lookups of states without mapping and fallback (no action).
+  size_t getUnresolved() const;
+
+  /// @brief Get the number of misses of all Strategy instances.
+  static size_t getTotalMisses();
+
+  /// @brief Get the number of lookups without action of all Strategy instances.
+  static size_t getTotalUnresolved();
+
+  /** @brief Get the parsed strategy table, e.g. to cache it.
+   *
+   * @return A reference to the strategy table.
+   */
+  const StrategyTable &getStrategyTable() const;
+
+  /** @brief Replace the strategy table without parsing a .sched file.
+   *
+   * @param table A strategy table of a model with the same labels.
+   */
+  void setStrategyTable(const StrategyTable &table);
+
+  /** @brief Get the max. state values covered by the Strategy.
+   *
+   * @return A list of Integer with the max. state values, empty if no Strategy is loaded.
    */
-  int getStrategyAction(const std::vector<int> &state, int currentAction);
+  std::vector<int> getStateSpace() const;
 
-  /// @brief Export the parsed Strategy in a user friendly format.
+  /// @brief Export the parsed Strategy in a user friendly format and the binary strategy format.
   void exportStrategy();
 
+  /** @brief Write a strategy table in the .strat format (state,...;action -> nextAction).
+   *
+   * @param out A output stream.
+   * @param table A strategy table.
+   */
+  static void writeStrategyTable(std::ostream &out, const StrategyTable &table);
+
+  /** @brief Read a strategy table in the .strat format, comment lines are skipped.
+   *
+   * @param in A input stream.
+   * @param table A strategy table filled by the method.
+   * @return A Boolean, True if all lines are parsed, False otherwise.
+   */
+  static bool readStrategyTable(std::istream &in, StrategyTable &table);
+
+  /** @brief Write a strategy table in the binary strategy format.
+   *
+   * @details The format (version STRATEGY_BINARY_VERSION, host byte order) holds a header
+   * ("ASST", version, layout, lane count, action count, mapping count), the labels (0 terminated, padded to 8 bytes),
+   * the bounds and max. state values of the lanes, the packed dense entries (uint16, next action + 1)
+   * or the mapping rows (int32, state..., action, next action) of sparse tables,
+   * and a 64 bit FNV-1a checksum of the preceding bytes.
+   * @param out A binary output stream.
+   * @param table A strategy table.
+   * @param labels A list of Strings with the lane labels in state order, may be empty.
+   */
+  static void writeBinaryStrategyTable(std::ostream &out, const StrategyTable &table,
+                                       const std::vector<std::string> &labels);
+
+  /** @brief Load a file in the binary strategy format.
+   * Dense entries are read in one block into the table without parsing or a further copy.
+   *
+   * @param filename A String with the path of the file.
+   * @param table A strategy table filled by the method.
+   * @param labels A list of Strings filled with the lane labels of the file.
+   * @return A Boolean, True if the file is valid (version, size and checksum), False otherwise.
+   */
+  static bool loadBinaryStrategyTable(const std::string &filename, StrategyTable &table,
+                                      std::vector<std::string> &labels);
+
   /// @brief Load the .sched file in the Strategy instance.
   void loadSchedFile();
 
+  /** @brief Load a scheduler exported by STORM in the Strategy instance.
+   *
+   * @param in A stream with the content of a .sched file.
+   */
+  void loadSched(std::istream &in);
+
+  /** @brief Load a scheduler of the explicit DRN model in the Strategy instance.
+   * The states are decoded from the state index, see ShieldModelGenerator::writeDRNModel.
+   *
+   * @param in A stream with the content of a .sched file.
+   * @param modelStateSpace A list of Integers with the state space of the model.
+   * @param actionCount A Integer with the number of actions of the model.
+   * @return A Boolean, True if all scheduler lines are parsed, False otherwise (invalid lines are skipped).
+   */
+  bool loadExplicitSched(std::istream &in, const std::vector<int> &modelStateSpace, size_t actionCount);
+
   /** @brief Parse a lane of the .shed file.
    *
    * @param line A String with the line of the .sched file.
@@ -74,5 +308,29 @@ class Strategy {
    * @return A Boolean, True if the line is successfully parsed, False otherwise.
    */
   bool parseSchedFileLine(const std::string &line, std::vector<int> &state, int &currentAction, int &nextAction);
+
+ private:
+  /// @brief Drop the fallbacks after the table changed.
+  void resetFallbacks();
+
+  /** @brief Get the fallback of a state without mapping, it is remembered for the next miss.
+   * Tables beyond the dense layout and states outside the covered state space search it per lookup.
+   *
+   * @param state A list of Integer with state values.
+   * @param currentAction A Integer with the current action/phase index.
+   * @return A Integer with the next action, -1 if no neighbour has a mapping.
+   */
+  int resolveFallback(const std::vector<int> &state, int currentAction) noexcept;
+
+  /// @brief Check if a state is inside the covered state space, which the remembered fallbacks cover.
+  bool covers(const std::vector<int> &state) const noexcept;
+
+  /** @brief Get the mapping of the nearest covered state.
+   *
+   * @param state A list of Integer with state values.
+   * @param currentAction A Integer with the current action/phase index.
+   * @return A Integer with the next action, -1 if no neighbour has a mapping.
+   */
+  int findFallback(const std::vector<int> &state, int currentAction) const noexcept;
 };
 #endif //INCLUDE_STRATEGY_H_
\ No newline at end of file
@@ -0,0 +1,111 @@
+#ifndef INCLUDE_STRATEGYCACHE_H_
+#define INCLUDE_STRATEGYCACHE_H_
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Strategy.h"
+#include "Util.h"
+
+/** @class StrategyCache
+ * Singleton which keeps the strategy tables of solved models in memory.
+ *
+ * @details The tables are addressed by the model key (hash of the generated PRISM program and properties).
+ * A hit replaces the STORM run, the .sched file and the parsing. The cache is bounded,
+ * the least recently used table gets evicted first.
+ *
+ * With a cache directory (--cache-dir) the tables are shared between runs and parallel processes.
+ * The files use the binary strategy format (see Strategy::writeBinaryStrategyTable), a disk hit reads the file
+ * without parsing, corrupted files fail the checksum and get removed.
+ * Files are written atomically (rename of a temporary file), the file modification time
+ * tracks the last use and the eviction of the oldest files is serialized by a lock file.
+ * The size of the directory is tracked between the scans, a insert does not scan the directory
+ * and a full directory is evicted to 90% of the limit.
+ */
+class StrategyCache {
+ private:
+  typedef std::pair<std::string, StrategyTable> CacheEntry;
+
+  std::list<CacheEntry> entries;
+  std::map<std::string, std::list<CacheEntry>::iterator> index;
+  size_t capacity{STRATEGY_CACHE_SIZE};
+
+  size_t hits{0};
+  size_t diskHits{0};
+  size_t misses{0};
+
+  /// Size of the cache directory since the last scan plus the files stored since, -1 before the first scan.
+  long long diskSize{-1};
+  /// Files stored since the last scan, files of parallel processes are only seen by a scan.
+  size_t diskInserts{0};
+
+ public:
+  /// @brief Get the Singleton instance
+  static StrategyCache &instance() {
+    static StrategyCache _instance;
+    return _instance;
+  }
+
+  ~StrategyCache() = default;
+
+  /** @brief Find the strategy table of a model.
+   *
+   * @param key A String with the model key.
+   * @param table A strategy table filled by the method on a hit.
+   * @return True on a hit, False otherwise.
+   */
+  bool lookup(const std::string &key, StrategyTable &table);
+
+  /** @brief Store the strategy table of a solved model.
+   *
+   * @param key A String with the model key.
+   * @param table The strategy table STORM created for the model.
+   */
+  void insert(const std::string &key, const StrategyTable &table);
+
+  /// @brief Get the number of cache hits.
+  size_t getHits() const;
+
+  /// @brief Get the number of cache hits loaded from the cache directory.
+  size_t getDiskHits() const;
+
+  /// @brief Get the number of cache misses.
+  size_t getMisses() const;
+
+ private:
+  /** @brief Get the filename of the model key in the cache directory.
+   *
+   * @param key A String with the model key.
+   * @return A String with the path, empty if no cache directory is set.
+   */
+  static std::string getCacheFile(const std::string &key);
+
+  /** @brief Get the lane labels of the cache files, the lane positions as in the model key.
+   *
+   * @param laneCount A Integer with the number of lanes.
+   * @return A list of Strings with the labels lane0, lane1, ...
+   */
+  static std::vector<std::string> getPositionLabels(size_t laneCount);
+
+  /// @brief Load the strategy table from the cache directory.
+  bool loadFromDisk(const std::string &key, StrategyTable &table);
+
+  /// @brief Store the strategy table atomically in the cache directory.
+  void storeToDisk(const std::string &key, const StrategyTable &table);
+
+  /** @brief Remove the least recently used files until the cache directory fits the size limit.
+   * The directory is scanned if the tracked size exceeds the limit or after CACHE_DIR_SCAN_INTERVAL stored files.
+   *
+   * @param storedSize A Integer with the size of the stored file.
+   */
+  void evictFromDisk(long long storedSize);
+
+  /// Hide from user.
+  StrategyCache() = default;
+  StrategyCache(const StrategyCache &) = delete;
+  StrategyCache &operator=(const StrategyCache &) = delete;
+};
+
+#endif //INCLUDE_STRATEGYCACHE_H_
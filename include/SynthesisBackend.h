@@ -0,0 +1,154 @@
+#ifndef INCLUDE_SYNTHESISBACKEND_H_
+#define INCLUDE_SYNTHESISBACKEND_H_
+
+#include <map>
+#include <memory>
+#include <vector>
+#include <string>
+#include <ostream>
+
+struct STORMModel;
+
+/** @class SynthesisBackend
+ * Interface of the strategy synthesis engines.
+ *
+ * @details External backends are started by the STORMConnector job pool with their command line,
+ * in-process backends solve the model in the simulation process (Shield with its MDPSolver).
+ * Backends are named by --synthesis-backend:
+ * native, storm or storm:ENGINE[:METHOD] with the STORM engine (sparse, hybrid or dd)
+ * and the --minmax:method of STORM (e.g. storm::pi keeps the default engine).
+ */
+class SynthesisBackend {
+ public:
+  virtual ~SynthesisBackend() = default;
+
+  /** @brief Create a backend by its name.
+   *
+   * @param name A String with the backend name.
+   * @return The backend, nullptr if the name is unknown.
+   */
+  static std::unique_ptr<SynthesisBackend> create(const std::string &name);
+
+  /// @brief Get the name of the backend, create(getName()) results in the same backend.
+  virtual std::string getName() const = 0;
+
+  /// @brief Check if the backend solves in the simulation process, False if it runs in the job pool.
+  virtual bool isInProcess() const = 0;
+
+  /** @brief Get the command line of an external backend.
+   *
+   * @param model The model of the job.
+   * @param modelPath A String with the path of the model file.
+   * @param schedPath A String with the path the scheduler gets exported to.
+   * @return A list of Strings with the program and its arguments, empty for in-process backends.
+   */
+  virtual std::vector<std::string> getCommand(const struct STORMModel &model, const std::string &modelPath,
+                                              const std::string &schedPath) const = 0;
+};
+
+/** @class StormBackend
+ * STORM with a engine and minmax method, empty settings keep the defaults of STORM.
+ */
+class StormBackend : public SynthesisBackend {
+  std::string engine;
+  std::string method;
+
+ public:
+  StormBackend(std::string engine, std::string method);
+
+  std::string getName() const override;
+  bool isInProcess() const override;
+  std::vector<std::string> getCommand(const struct STORMModel &model, const std::string &modelPath,
+                                      const std::string &schedPath) const override;
+};
+
+/** @class NativeBackend
+ * The in-process solver (MDPSolver).
+ */
+class NativeBackend : public SynthesisBackend {
+ public:
+  std::string getName() const override;
+  bool isInProcess() const override;
+  std::vector<std::string> getCommand(const struct STORMModel &model, const std::string &modelPath,
+                                      const std::string &schedPath) const override;
+};
+
+/** @class BackendCalibration
+ * Singleton which selects the synthesis backend of a model.
+ *
+ * @details With --synthesis-backend auto the first models of each size class (decade of the predicted
+ * number of states) are solved by every backend of --calibration-backends in turn. The measured wall
+ * time per state decides the backend of the further models of the class, failed backends are skipped.
+ * Otherwise the configured backend solves all models.
+ */
+class BackendCalibration {
+ private:
+  /**
+   * Struct Calibration. Contains the measurements of a backend in a size class.
+   */
+  struct Calibration {
+    size_t assigned{0};
+    size_t measured{0};
+    double timePerState{0.};
+    bool failed{false};
+  };
+
+  // Size class -> backend name -> measurements.
+  std::map<size_t, std::map<std::string, struct Calibration>> classes;
+  // Size classes with a reported choice.
+  std::map<size_t, std::string> choices;
+
+ public:
+  /// @brief Get the Singleton instance
+  static BackendCalibration &instance() {
+    static BackendCalibration _instance;
+    return _instance;
+  }
+
+  ~BackendCalibration() = default;
+
+  /** @brief Select the backend for a model.
+   * A calibration run counts as assigned, call the method only if the model gets solved.
+   *
+   * @param states A Integer with the predicted number of states.
+   * @return A String with the backend name.
+   */
+  std::string select(size_t states);
+
+  /** @brief Record a finished synthesis of a selected backend.
+   *
+   * @param backend A String with the backend name.
+   * @param states A Integer with the predicted number of states.
+   * @param success A Boolean, True if the backend found a strategy.
+   * @param wallTime A Float with the wall clock time in s.
+   */
+  void record(const std::string &backend, size_t states, bool success, double wallTime);
+
+  /** @brief Get the size class of a model.
+   *
+   * @param states A Integer with the predicted number of states.
+   * @return A Integer with the decade of the number of states.
+   */
+  static size_t getSizeClass(size_t states);
+
+  /** @brief Print the chosen backend of each calibrated size class.
+   *
+   * @param out A stream the summary gets written to.
+   */
+  void printSummary(std::ostream &out) const;
+
+ private:
+  /// Hide from user.
+  BackendCalibration() = default;
+  BackendCalibration(const BackendCalibration &) = delete;
+  BackendCalibration &operator=(const BackendCalibration &) = delete;
+
+  /** @brief Get the fastest backend of a size class.
+   *
+   * @param sizeClass A Integer with the size class.
+   * @return A String with the backend name, empty if no backend succeeded yet.
+   */
+  std::string getFastest(size_t sizeClass) const;
+};
+
+#endif //INCLUDE_SYNTHESISBACKEND_H_
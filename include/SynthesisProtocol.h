@@ -0,0 +1,52 @@
+#ifndef INCLUDE_SYNTHESISPROTOCOL_H_
+#define INCLUDE_SYNTHESISPROTOCOL_H_
+
+#include <string>
+
+#include "STORMConnector.h"
+#include "Strategy.h"
+#include "SynthesisTelemetry.h"
+
+/**
+ * Protocol between the simulation and the synthesis worker (adaptiveShielding-synthd).
+ *
+ * The simulation connects to the Unix socket of the worker for each job and sends one request,
+ * the worker answers with one response. Both are JSON objects terminated by a newline.
+ * A request contains the model (key, PRISM program, constants, properties, lane labels, explicit model, backend),
+ * a response the measurements of the synthesis and the strategy table (state..., action, next action).
+ * Closing the connection cancels the job.
+ */
+
+/** @brief Encode a synthesis request.
+ *
+ * @param model The model to solve.
+ * @return A String with the request line.
+ */
+std::string encodeRequest(const struct STORMModel &model);
+
+/** @brief Decode a synthesis request.
+ *
+ * @param line A String with the request line.
+ * @param model The model filled by the function.
+ * @return True if the request is valid, False otherwise.
+ */
+bool decodeRequest(const std::string &line, struct STORMModel &model);
+
+/** @brief Encode a synthesis response.
+ *
+ * @param record The measurements of the synthesis.
+ * @param table The strategy table, empty if the synthesis failed.
+ * @return A String with the response line.
+ */
+std::string encodeResponse(const struct SynthesisRecord &record, const StrategyTable &table);
+
+/** @brief Decode a synthesis response.
+ *
+ * @param line A String with the response line.
+ * @param record The measurements filled by the function.
+ * @param table The strategy table filled by the function.
+ * @return True if the response is valid, False otherwise.
+ */
+bool decodeResponse(const std::string &line, struct SynthesisRecord &record, StrategyTable &table);
+
+#endif //INCLUDE_SYNTHESISPROTOCOL_H_
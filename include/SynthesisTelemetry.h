@@ -0,0 +1,88 @@
+#ifndef INCLUDE_SYNTHESISTELEMETRY_H_
+#define INCLUDE_SYNTHESISTELEMETRY_H_
+
+#include <fstream>
+#include <string>
+
+/**
+ * Struct SynthesisRecord. Contains the measurements of one strategy synthesis.
+ */
+struct SynthesisRecord {
+  std::string junction;
+  std::string modelKey;
+  /// Synthesis backend (SynthesisBackend name, synthd or cache).
+  std::string backend;
+  bool speculative{false};
+  /// Outcome of the job (success, failed, timeout, signal or error if the scheduler is malformed).
+  std::string outcome;
+  int exitCode{-1};
+  /// Wall clock time from fork to exit in s.
+  double wallTime{0.};
+  /// User and system CPU time in s.
+  double cpuTime{0.};
+  /// Peak resident set size in kB.
+  long peakRSS{0};
+  /// Model size reported by STORM, 0 if unknown.
+  size_t states{0};
+  size_t transitions{0};
+  size_t choices{0};
+  /// Model size predicted before the generation.
+  size_t predictedStates{0};
+};
+
+/** @class SynthesisTelemetry
+ * Singleton which collects the measurements of the strategy syntheses.
+ *
+ * @details Every record is appended as JSON line to the telemetry file (--telemetry),
+ * the summary counters are printed at shutdown.
+ */
+class SynthesisTelemetry {
+ private:
+  std::ofstream file;
+
+  size_t jobs{0};
+  size_t succeeded{0};
+  size_t failed{0};
+  size_t timeouts{0};
+  size_t speculative{0};
+  double wallTime{0.};
+  double cpuTime{0.};
+  long peakRSS{0};
+  size_t states{0};
+
+ public:
+  /// @brief Get the Singleton instance
+  static SynthesisTelemetry &instance() {
+    static SynthesisTelemetry _instance;
+    return _instance;
+  }
+
+  ~SynthesisTelemetry() = default;
+
+  /** @brief Count the record and append it to the telemetry file.
+   *
+   * @param record The measurements of a finished synthesis.
+   */
+  void record(const struct SynthesisRecord &record);
+
+  /** @brief Parse the model size from the output of STORM.
+   *
+   * @param output A String with the output of the STORM process.
+   * @param record The record which gets the number of states, transitions and choices.
+   */
+  static void parseModelSize(const std::string &output, struct SynthesisRecord &record);
+
+  /** @brief Print the summary counters.
+   *
+   * @param out A stream the summary gets written to.
+   */
+  void printSummary(std::ostream &out) const;
+
+ private:
+  /// Hide from user.
+  SynthesisTelemetry() = default;
+  SynthesisTelemetry(const SynthesisTelemetry &) = delete;
+  SynthesisTelemetry &operator=(const SynthesisTelemetry &) = delete;
+};
+
+#endif //INCLUDE_SYNTHESISTELEMETRY_H_
@@ -42,10 +42,14 @@ class TrafficLight : public ISimulationObject {
 
   bool activeShield{false};
 
+  // time step in the update interval the shield gets updated
+  size_t updateOffset{0};
+
  public:
   /** @brief Factory Method, create a TrafficLight instance.
    *
    * @details With tlsID everything get generated from SUMO information.
+   * The initial strategy is not synthesized yet, Simulation starts the syntheses of all traffic lights at once.
    */
   static TrafficLight *build(SUMOConnector *sumo, const std::string &tlsID);
 
@@ -53,6 +57,7 @@ class TrafficLight : public ISimulationObject {
    *
    * @details With configuration file we generate first all modules and than load the config values.
    * By that we check if the information in the config file matches and there is no problem with the orders and names.
+   * The initial strategy is not synthesized yet, see build().
    */
   static TrafficLight *buildFromFile(SUMOConnector *sumo, const std::string &shieldConfigFile);
 
@@ -84,6 +89,12 @@ class TrafficLight : public ISimulationObject {
   /// @brief Get the Shield instance.
   Shield *getShield();
 
+  /** @brief Set the time step in the update interval the shield gets updated.
+   *
+   * @param offset A Integer with the offset, less than the update interval.
+   */
+  void setUpdateOffset(size_t offset);
+
   /// @brief Simulation Step Method, called in Simulation Class.
   void step() override;
 
@@ -5,6 +5,8 @@
 #include <string>
 #include <map>
 #include <set>
+#include <sys/types.h>
+#include <sys/resource.h>
 
 #define out_path_ "out/"
 
@@ -32,6 +34,30 @@
 #define DEFAULT_UPDATE_INTERVAL 500
 #define DEFAULT_WARMUP_TIME 900
 
+#define DEFAULT_SYNTHESIS_JOBS 4
+#define DEFAULT_SYNTHESIS_TIMEOUT 180
+#define SYNTHESIS_KILL_GRACE 5
+#define SYNTHESIS_MAX_BACKOFF 32
+#define PRLIMIT_PATH "/usr/bin/prlimit"
+#define SYNTHESIS_MAX_REQUEST (16 << 20)
+
+#define PRIORITY_WEIGHT_PROBABILITY 10.
+#define PRIORITY_WEIGHT_STATE 1.
+#define PRIORITY_WEIGHT_OVERFLOW 2.
+#define PRIORITY_WEIGHT_AGE 0.1
+#define STRATEGY_CACHE_SIZE 64
+#define STRATEGY_TABLE_DENSE_MAX (1 << 25)
+#define STRATEGY_BINARY_VERSION 1
+#define DEFAULT_CACHE_DIR_SIZE 256
+#define CACHE_DIR_SCAN_INTERVAL 32
+#define MAX_TEMPLATE_FILES 256
+#define CALIBRATION_RUNS 2
+
+#define NATIVE_SOLVER_MAX_STATES 20000000
+#define NATIVE_SOLVER_MAX_ITERATIONS 100000
+#define NATIVE_SOLVER_EPSILON 1.0e-6
+#define NATIVE_SOLVER_APERIODICITY 0.9
+
 #define STEP_IN_DELTA 5
 #define DEFAULT_LAMBDA 0.2
 #define DEFAULT_D 3
@@ -72,10 +98,33 @@ struct configInfo {
   bool unshielded{false};
   bool sideBySide{false};
   bool staticUpdate{false};
+  bool staggerUpdates{false};
   bool gui{false};
   bool noTrees{false};
   bool client{false};
   bool overwrite{false};
+  size_t synthesisJobs{DEFAULT_SYNTHESIS_JOBS};
+  size_t synthesisTimeout{DEFAULT_SYNTHESIS_TIMEOUT};
+  size_t synthesisMemory{0};
+  size_t stateBudget{0};
+  size_t subShieldLanes{0};
+  double timeBudget{0.};
+  bool asyncUpdate{false};
+  bool lazyShields{false};
+  bool noStrategyCache{false};
+  std::string cacheDir;
+  size_t cacheDirSize{DEFAULT_CACHE_DIR_SIZE};
+  std::string backend{"storm"};
+  std::vector<std::string> calibrationBackends{"storm", "storm:hybrid", "storm:dd", "native"};
+  bool symmetryReduction{false};
+  double quantization{0.};
+  std::string quantizationMode{"lattice"};
+  bool debugFiles{false};
+  bool explicitModel{false};
+  bool parametricModel{false};
+  bool speculative{false};
+  std::string telemetryFile;
+  std::string synthdSocket;
   int port{-1};
 };
 
@@ -100,6 +149,14 @@ struct blockEventInfo {
   std::string rerouteLaneID{};
 };
 
+/** @struct processInfo
+ * Handle of a started program.
+ */
+struct processInfo {
+  pid_t pid{-1};
+  int pidfd{-1}; // process file descriptor to poll on the exit, -1 if not supported
+};
+
 /** @brief Read the IGNORE FILE given by the program argument.
  *
  * @param ignoreFiles A list of Strings with filenames.
@@ -117,6 +174,33 @@ std::vector<struct blockEventInfo> readBlockFile(std::string &blockFile);
 /// @brief Parse the arguments to the global struct.
 void parse_args(int argc, char *argv[], struct configInfo &config);
 
+/** @brief Start a program with posix_spawn.
+ *
+ * @details The simulation holds large maps and strategy tables, posix_spawn does not copy its
+ * page tables like fork() does. The program inherits only the standard streams and the given
+ * file descriptors, SIGPIPE is reset to the default action.
+ *
+ * @param args A list of String with the path of the program and its arguments.
+ * @param logFile A String with the file stdout and stderr get appended to, empty to keep the streams.
+ * @param logFd A Integer with a file descriptor for stdout and stderr, used instead of logFile if not -1.
+ * @param inheritFds A list of file descriptors the program inherits with the same numbers.
+ * @return A processInfo with the pid (-1 on error) and the process file descriptor.
+ */
+struct processInfo spawnProcess(const std::vector<std::string> &args,
+                                const std::string &logFile = "",
+                                int logFd = -1,
+                                const std::vector<int> &inheritFds = {});
+
+/** @brief Wait for a started program, the process file descriptor gets closed after the exit.
+ *
+ * @param process The handle of the program.
+ * @param waitStatus The status of the program.
+ * @param options Options of wait4, e.g. WNOHANG.
+ * @param usage The resource usage of the finished program, nullptr to ignore it.
+ * @return The pid if the state changed, 0 if WNOHANG is set and the program is running, -1 on error.
+ */
+pid_t waitProcess(struct processInfo &process, int &waitStatus, int options = 0, struct rusage *usage = nullptr);
+
 /// @brief Start Python with the plot script with the log file of all simulations.
 void pythonPlot(const std::vector<char *> &logFiles);
 
@@ -137,6 +221,21 @@ std::string getValueForToken(std::string const &str, std::string const &token);
 /// @brief Create a probability mass function from the input.
 std::vector<float> calculatePMF(std::vector<int> &tracking);
 
+/** @brief Quantize a probability mass function with the configured step size (--quantization).
+ *
+ * @details The "grid" mode rounds every probability to the step size and renormalizes the sum.
+ * The "lattice" mode picks the nearest point on the simplex lattice with resolution 1/step
+ * (largest remainder), positive probabilities keep at least one step.
+ * Without quantization the input is returned.
+ *
+ * @param probabilities A list of Floats which sum up to 1.
+ * @return A list of Floats with the quantized probabilities.
+ */
+std::vector<float> quantizePMF(const std::vector<float> &probabilities);
+
+/// @brief Get the summed absolute difference of two lists of the same size.
+float getDelta(const std::vector<float> &a, const std::vector<float> &b);
+
 /// @brief Check if file exists.
 bool fileExist(const std::string &path);
 
@@ -155,4 +254,10 @@ void reformatName(std::string &name);
 /// @brief Get a String with the timestamp.
 std::string getTimeString();
 
+/// @brief Get a stable 64 bit FNV-1a hash of a byte buffer, the hash of the preceding buffers continues it.
+uint64_t hashBytes(const char *data, size_t size, uint64_t hash = 14695981039346656037ULL);
+
+/// @brief Get a stable 64 bit FNV-1a hash of the String, used as content address.
+std::string hashString(const std::string &str);
+
 #endif //INCLUDE_UTIL_H_
\ No newline at end of file
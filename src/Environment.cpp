@@ -161,7 +161,7 @@ std::vector<float> Environment::getProbabilities() const {
   return probabilities;
 }
 
-std::vector<int> Environment::getHaltingNumbers() {
+std::vector<int> Environment::getHaltingNumbers() const {
   return haltingNumbers;
 }
 
@@ -0,0 +1,356 @@
+#include <cmath>
+#include <cassert>
+#include <limits>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+
+#include "MDPSolver.h"
+#include "ShieldModelGenerator.h"
+#include "Environment.h"
+#include "Controller.h"
+#include "Util.h"
+
+bool MDPSolver::solve(const Environment &environment, const Controller &controller, StrategyTable &table) {
+  return solve(ShieldModelGenerator::getExplicitModel(environment, controller), table);
+}
+
+bool MDPSolver::solve(const struct ExplicitModel &model, StrategyTable &table) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(gConfig.synthesisTimeout);
+  const auto &stateSpace = model.stateSpace;
+  const auto &laneProbabilities = model.laneProbabilities;
+  const auto &actionProbabilities = model.actionProbabilities;
+  const auto &wayLanes = model.ways;
+
+  size_t laneCount = model.labels.size();
+  size_t actionCount = wayLanes.size();
+
+  // mixed radix index of the lane states, the first lane has the smallest stride
+  std::vector<size_t> strides(laneCount);
+  size_t laneStateCount = 1;
+  for(size_t i = 0; i < laneCount; i++) {
+    strides[i] = laneStateCount;
+    laneStateCount *= stateSpace[i] + 1;
+  }
+
+  std::vector<std::vector<size_t>> classes;
+  if(gConfig.symmetryReduction) {
+    classes = getLaneClasses(stateSpace, laneProbabilities, wayLanes);
+  } else {
+    for(size_t i = 0; i < laneCount; i++) {
+      classes.push_back({i});
+    }
+  }
+  bool reduced = classes.size() < laneCount;
+
+  // one model state per orbit: multisets of the counters of each class
+  std::vector<size_t> next(laneCount, laneCount);
+  size_t stateCount = 1;
+  for(const auto &laneClass : classes) {
+    size_t size = laneClass.size();
+    size_t max = stateSpace[laneClass.front()];
+    for(size_t m = 1; m <= size; m++) {
+      stateCount = stateCount*(max + m)/m;
+    }
+    for(size_t c = 0; c + 1 < size; c++) {
+      next[laneClass[c]] = laneClass[c + 1];
+    }
+  }
+
+  if(stateCount*actionCount > NATIVE_SOLVER_MAX_STATES) {
+    std::cerr << "Native solver: model with " << stateCount*actionCount << " states exceeds the limit." << std::endl;
+    return false;
+  }
+
+  // model and lane states, rewards, environment and shield targets and the value vectors
+  size_t memory = stateCount*(sizeof(size_t) + laneCount*(sizeof(int) + sizeof(size_t)) + 3*sizeof(double)
+      + actionCount*(sizeof(size_t) + 3*sizeof(double)));
+  if(gConfig.synthesisMemory > 0 && memory > gConfig.synthesisMemory*1024*1024) {
+    std::cerr << "Native solver: model needs " << memory/(1024*1024) << " MB and exceeds the memory limit." << std::endl;
+    return false;
+  }
+
+  // enumerate the representatives in index order, the counters of a class are ascending
+  std::vector<size_t> states;
+  std::vector<int> coords;
+  states.reserve(stateCount);
+  coords.reserve(stateCount*laneCount);
+  std::vector<int> state(laneCount, 0);
+  size_t index = 0;
+  while(true) {
+    states.push_back(index);
+    coords.insert(coords.end(), state.begin(), state.end());
+
+    size_t i = 0;
+    for(; i < laneCount; i++) {
+      int max = next[i]!=laneCount ? state[next[i]] : stateSpace[i];
+      if(state[i] < max) {
+        state[i]++;
+        index += strides[i];
+        break;
+      }
+      index -= state[i]*strides[i];
+      state[i] = 0;
+    }
+    if(i==laneCount) {
+      break;
+    }
+  }
+  assert(states.size()==stateCount && "Wrong number of orbit representatives!");
+
+  auto modelState = [&](size_t laneState) {
+    return reduced ? (size_t)(std::lower_bound(states.begin(), states.end(), laneState) - states.begin()) : laneState;
+  };
+
+  std::vector<double> rewards(stateCount, 0.);
+  std::vector<size_t> decrements(stateCount*actionCount);
+  std::vector<size_t> increments(stateCount*laneCount);
+  std::vector<double> wayMax(actionCount);
+
+  for(size_t s = 0; s < stateCount; s++) {
+
+    // environment move: the lane gets one vehicle more
+    for(size_t i = 0; i < laneCount; i++) {
+      size_t target = states[s];
+      if(coords[s*laneCount + i] < stateSpace[i]) {
+        target += strides[i];
+        if(reduced) {
+          state.assign(coords.begin() + s*laneCount, coords.begin() + (s + 1)*laneCount);
+          state[i]++;
+          target = canonicalize(state, classes, stateSpace);
+        }
+      }
+      increments[s*laneCount + i] = modelState(target);
+    }
+
+    // shield move: the lanes of the way get one vehicle less
+    for(size_t k = 0; k < actionCount; k++) {
+      size_t target = states[s];
+      int max = 0;
+      state.assign(coords.begin() + s*laneCount, coords.begin() + (s + 1)*laneCount);
+      for(auto lane : wayLanes[k]) {
+        int value = coords[s*laneCount + lane];
+        if(value > 0) {
+          target -= strides[lane];
+          state[lane]--;
+        }
+        max = std::max(max, value);
+      }
+      if(reduced) {
+        target = canonicalize(state, classes, stateSpace);
+      }
+      decrements[s*actionCount + k] = modelState(target);
+      wayMax[k] = max;
+    }
+
+    // reward: max. difference of the way queues
+    bool first = true;
+    for(size_t k1 = 0; k1 < actionCount; k1++) {
+      for(size_t k2 = 0; k2 < actionCount; k2++) {
+        if(wayLanes[k1]!=wayLanes[k2]) {
+          double difference = wayMax[k1] - wayMax[k2];
+          rewards[s] = first ? difference : std::max(rewards[s], difference);
+          first = false;
+        }
+      }
+    }
+  }
+
+  std::vector<double> h = getInitialValues(stateSpace, actionCount, coords);
+  std::vector<double> hNew(stateCount*actionCount);
+  std::vector<double> afterController(stateCount);
+  std::vector<double> afterEnvironment(stateCount);
+
+  const double d = gConfig.d;
+  const double tau = NATIVE_SOLVER_APERIODICITY;
+
+  auto bellman = [&](size_t x, size_t j, size_t k) {
+    return rewards[x] + (k!=j ? d : 0.)
+        + 0.9*afterEnvironment[decrements[x*actionCount + k]] + 0.1*afterEnvironment[x];
+  };
+
+  size_t iteration = 0;
+  for(; iteration < NATIVE_SOLVER_MAX_ITERATIONS; iteration++) {
+    // controller move
+    for(size_t x = 0; x < stateCount; x++) {
+      double value = 0.;
+      for(size_t j = 0; j < actionCount; j++) {
+        value += actionProbabilities[j]*h[x*actionCount + j];
+      }
+      afterController[x] = value;
+    }
+
+    // environment move: one lane gets a vehicle more
+    for(size_t x = 0; x < stateCount; x++) {
+      double value = 0.;
+      for(size_t i = 0; i < laneCount; i++) {
+        value += laneProbabilities[i]*afterController[increments[x*laneCount + i]];
+      }
+      afterEnvironment[x] = value;
+    }
+
+    double minDelta = std::numeric_limits<double>::max();
+    double maxDelta = std::numeric_limits<double>::lowest();
+    for(size_t x = 0; x < stateCount; x++) {
+      for(size_t j = 0; j < actionCount; j++) {
+        double best = std::numeric_limits<double>::max();
+        for(size_t k = 0; k < actionCount; k++) {
+          best = std::min(best, bellman(x, j, k));
+        }
+
+        size_t s = x*actionCount + j;
+        hNew[s] = tau*best + (1. - tau)*h[s];
+        minDelta = std::min(minDelta, hNew[s] - h[s]);
+        maxDelta = std::max(maxDelta, hNew[s] - h[s]);
+      }
+    }
+
+    // relative values, keep them bounded
+    double reference = hNew[0];
+    for(auto &value : hNew) {
+      value -= reference;
+    }
+    h.swap(hNew);
+
+    if(maxDelta - minDelta < NATIVE_SOLVER_EPSILON) {
+      break;
+    }
+
+    if(std::chrono::steady_clock::now() > deadline) {
+      std::cerr << "Native solver: value iteration exceeded the time limit." << std::endl;
+      return false;
+    }
+  }
+
+  if(iteration==NATIVE_SOLVER_MAX_ITERATIONS) {
+    std::cerr << "Native solver: value iteration did not converge, use the current values." << std::endl;
+  }
+
+  std::vector<int> choices(stateCount*actionCount);
+  for(size_t s = 0; s < stateCount; s++) {
+    for(size_t j = 0; j < actionCount; j++) {
+      // prefer to keep the current action on ties
+      size_t bestAction = j;
+      double best = bellman(s, j, j);
+      for(size_t k = 0; k < actionCount; k++) {
+        double value = bellman(s, j, k);
+        if(value < best - NATIVE_SOLVER_EPSILON) {
+          best = value;
+          bestAction = k;
+        }
+      }
+      choices[s*actionCount + j] = (int)bestAction;
+    }
+  }
+
+  // expand the choices of the representatives to their orbits, the permutations keep the ways
+  table = StrategyTable(stateSpace, (int)actionCount);
+  std::vector<int> representative(laneCount);
+  for(size_t x = 0; x < laneStateCount; x++) {
+    for(size_t i = 0; i < laneCount; i++) {
+      state[i] = (int)((x/strides[i])%(stateSpace[i] + 1));
+    }
+    representative = state;
+    size_t s = reduced ? modelState(canonicalize(representative, classes, stateSpace)) : x;
+
+    for(size_t j = 0; j < actionCount; j++) {
+      table.set(state, (int)j, choices[s*actionCount + j]);
+    }
+  }
+
+  values = h;
+  valuesStateSpace = stateSpace;
+  valuesActionCount = actionCount;
+  valuesClasses = classes;
+  valuesStates.clear();
+  if(reduced) {
+    valuesStates = states;
+  }
+  // counted like the generated model, the three arbiter moves are folded into one step
+  modelStates = 3*stateCount*actionCount;
+
+  return true;
+}
+
+size_t MDPSolver::getModelStates() const {
+  return modelStates;
+}
+
+std::vector<std::vector<size_t>> MDPSolver::getLaneClasses(const std::vector<int> &stateSpace,
+                                                           const std::vector<float> &laneProbabilities,
+                                                           const std::vector<std::vector<size_t>> &wayLanes) {
+  size_t laneCount = stateSpace.size();
+  std::vector<std::vector<bool>> membership(laneCount, std::vector<bool>(wayLanes.size(), false));
+  for(size_t k = 0; k < wayLanes.size(); k++) {
+    for(auto lane : wayLanes[k]) {
+      membership[lane][k] = true;
+    }
+  }
+
+  std::vector<std::vector<size_t>> classes;
+  for(size_t i = 0; i < laneCount; i++) {
+    auto laneClass = std::find_if(classes.begin(), classes.end(), [&](const std::vector<size_t> &c) {
+      size_t l = c.front();
+      return stateSpace[l]==stateSpace[i] && laneProbabilities[l]==laneProbabilities[i] && membership[l]==membership[i];
+    });
+    if(laneClass==classes.end()) {
+      classes.push_back({i});
+    } else {
+      laneClass->push_back(i);
+    }
+  }
+  return classes;
+}
+
+size_t MDPSolver::canonicalize(std::vector<int> &state, const std::vector<std::vector<size_t>> &classes,
+                               const std::vector<int> &stateSpace) {
+  std::vector<int> counters;
+  for(const auto &laneClass : classes) {
+    counters.clear();
+    for(auto lane : laneClass) {
+      counters.push_back(state[lane]);
+    }
+    std::sort(counters.begin(), counters.end());
+    for(size_t c = 0; c < laneClass.size(); c++) {
+      state[laneClass[c]] = counters[c];
+    }
+  }
+
+  size_t index = 0;
+  size_t stride = 1;
+  for(size_t i = 0; i < state.size(); i++) {
+    index += state[i]*stride;
+    stride *= stateSpace[i] + 1;
+  }
+  return index;
+}
+
+std::vector<double> MDPSolver::getInitialValues(const std::vector<int> &stateSpace, size_t actionCount,
+                                                const std::vector<int> &coords) const {
+  size_t laneCount = stateSpace.size();
+  size_t stateCount = laneCount > 0 ? coords.size()/laneCount : 1;
+
+  std::vector<double> initialValues(stateCount*actionCount, 0.);
+  if(values.empty() || valuesStateSpace.size()!=laneCount || valuesActionCount!=actionCount) {
+    return initialValues;
+  }
+
+  std::vector<int> state(laneCount);
+  for(size_t s = 0; s < stateCount; s++) {
+    for(size_t i = 0; i < laneCount; i++) {
+      state[i] = std::min(coords[s*laneCount + i], valuesStateSpace[i]);
+    }
+
+    // the classes of the last solve may differ, map the clipped state to its old representative
+    size_t previous = canonicalize(state, valuesClasses, valuesStateSpace);
+    if(!valuesStates.empty()) {
+      previous = std::lower_bound(valuesStates.begin(), valuesStates.end(), previous) - valuesStates.begin();
+    }
+
+    for(size_t j = 0; j < actionCount; j++) {
+      initialValues[s*actionCount + j] = values[previous*actionCount + j];
+    }
+  }
+
+  return initialValues;
+}
@@ -2,67 +2,852 @@
 #include <fstream>
 #include <fcntl.h>
 #include <unistd.h>
+#include <poll.h>
+#include <csignal>
+#include <algorithm>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+#include <system_error>
 
 #include "STORMConnector.h"
 #include "Shield.h"
+#include "SynthesisBackend.h"
+#include "SynthesisProtocol.h"
 
-void STORMConnector::startStrategyUpdate(Shield *shield) {
-  // check if there is a active job
-  if(jobs.find(shield)!=jobs.end()) {
+void STORMConnector::startStrategyUpdate(Shield *shield, const struct STORMModel &model) {
+  const std::string &modelKey = model.key;
+  auto own = jobs.find(shield);
+  if(own!=jobs.end()) {
+    // check if there is a active job or the queued job has already the model
+    if(own->second.pid!=-1 || own->second.model.key==modelKey) {
+      return;
+    }
+
+    // the model changed, the subscribers still need the old model
+    promoteSubscribers(own->second);
+    jobs.erase(own);
+    pendingJobs.erase(std::remove(pendingJobs.begin(), pendingJobs.end(), shield), pendingJobs.end());
+  }
+
+  Shield *owner = findOwner(shield);
+  if(owner!=nullptr) {
+    auto &subscribers = jobs[owner].subscribers;
+    if(jobs[owner].model.key==modelKey) {
+      return;
+    }
+    subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), shield), subscribers.end());
+  }
+
+  // run STORM once per distinct model
+  for(auto &job : jobs) {
+    if(job.second.model.key==modelKey) {
+      job.second.subscribers.push_back(shield);
+      return;
+    }
+  }
+
+  // a speculative job has the model already, take it over
+  auto speculative = speculativeJobs.find(modelKey);
+  if(speculative!=speculativeJobs.end()) {
+    // the requester and subscribers of the speculative job still get the strategy as speculation
+    std::vector<Shield *> speculativeSubscribers{speculative->second.requester};
+    speculativeSubscribers.insert(speculativeSubscribers.end(), speculative->second.subscribers.begin(),
+                                  speculative->second.subscribers.end());
+    speculativeSubscribers.erase(std::remove(speculativeSubscribers.begin(), speculativeSubscribers.end(), shield),
+                                 speculativeSubscribers.end());
+
+    auto &job = jobs[shield];
+    job = std::move(speculative->second);
+    job.requester = nullptr;
+    job.subscribers.clear();
+    job.speculativeSubscribers = std::move(speculativeSubscribers);
+    if(job.pid==-1) {
+      pendingJobs.push_back(shield);
+    }
+
+    speculativeJobs.erase(speculative);
+    pendingSpeculativeJobs.erase(std::remove(pendingSpeculativeJobs.begin(), pendingSpeculativeJobs.end(), modelKey),
+                                 pendingSpeculativeJobs.end());
+    dispatch();
+    return;
+  }
+
+  jobs[shield].model = model;
+  pendingJobs.push_back(shield);
+  dispatch();
+}
+
+void STORMConnector::startSpeculativeUpdate(Shield *shield, const struct STORMModel &model) {
+  for(const auto &job : jobs) {
+    if(job.second.model.key==model.key) {
+      return;
+    }
+  }
+
+  auto speculative = speculativeJobs.find(model.key);
+  if(speculative!=speculativeJobs.end()) {
+    auto &job = speculative->second;
+    if(job.requester!=shield &&
+        std::find(job.subscribers.begin(), job.subscribers.end(), shield)==job.subscribers.end()) {
+      job.subscribers.push_back(shield);
+    }
+    return;
+  }
+
+  auto &job = speculativeJobs[model.key];
+  job.model = model;
+  job.requester = shield;
+  pendingSpeculativeJobs.push_back(model.key);
+  dispatch();
+}
+
+void STORMConnector::cancelSpeculativeUpdate(Shield *shield, const std::string &modelKey) {
+  auto speculative = speculativeJobs.find(modelKey);
+  if(speculative==speculativeJobs.end()) {
+    // a regular job may have taken the speculative job over
+    for(auto &job : jobs) {
+      auto &subscribers = job.second.speculativeSubscribers;
+      if(job.second.model.key==modelKey) {
+        subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), shield), subscribers.end());
+      }
+    }
+    return;
+  }
+
+  auto &job = speculative->second;
+  if(job.requester!=shield) {
+    job.subscribers.erase(std::remove(job.subscribers.begin(), job.subscribers.end(), shield), job.subscribers.end());
+    return;
+  }
+
+  if(!job.subscribers.empty()) {
+    job.requester = job.subscribers.front();
+    job.subscribers.erase(job.subscribers.begin());
+    return;
+  }
+
+  killJob(job);
+  speculativeJobs.erase(speculative);
+  pendingSpeculativeJobs.erase(std::remove(pendingSpeculativeJobs.begin(), pendingSpeculativeJobs.end(), modelKey),
+                               pendingSpeculativeJobs.end());
+  dispatch();
+}
+
+void STORMConnector::cancelSpeculativeUpdates(Shield *shield) {
+  std::vector<std::string> modelKeys;
+  for(const auto &job : speculativeJobs) {
+    modelKeys.push_back(job.first);
+  }
+  for(const auto &job : jobs) {
+    const auto &subscribers = job.second.speculativeSubscribers;
+    if(std::find(subscribers.begin(), subscribers.end(), shield)!=subscribers.end()) {
+      modelKeys.push_back(job.second.model.key);
+    }
+  }
+
+  for(const auto &modelKey : modelKeys) {
+    cancelSpeculativeUpdate(shield, modelKey);
+  }
+}
+
+bool STORMConnector::hasStrategyUpdate(Shield *shield) const {
+  return jobs.find(shield)!=jobs.end() || findOwner(shield)!=nullptr;
+}
+
+bool STORMConnector::isRunning(Shield *shield) const {
+  auto job = jobs.find(shield);
+  return job!=jobs.end() && job->second.pid!=-1;
+}
+
+void STORMConnector::poll() {
+  std::vector<Shield *> running;
+  for(const auto &job : jobs) {
+    if(job.second.pid!=-1) {
+      running.push_back(job.first);
+    }
+  }
+
+  for(auto shield : running) {
+    checkOnStorm(shield);
+  }
+
+  std::vector<std::string> speculative;
+  for(const auto &job : speculativeJobs) {
+    if(job.second.pid!=-1) {
+      speculative.push_back(job.first);
+    }
+  }
+
+  for(const auto &modelKey : speculative) {
+    checkOnSpeculativeStorm(modelKey);
+  }
+
+  dispatch();
+}
+
+void STORMConnector::waitForStrategyUpdate(Shield *shield) {
+  while(hasStrategyUpdate(shield)) {
+    poll();
+    if(hasStrategyUpdate(shield)) {
+      waitForAnyJob(100);
+    }
+  }
+}
+
+void STORMConnector::waitForAllStrategyUpdates() {
+  while(!jobs.empty()) {
+    poll();
+    if(!jobs.empty()) {
+      waitForAnyJob(100);
+    }
+  }
+}
+
+double STORMConnector::getThroughput() const {
+  return throughput;
+}
+
+void STORMConnector::cancelStrategyUpdate(Shield *shield) {
+  Shield *owner = findOwner(shield);
+  if(owner!=nullptr) {
+    auto &subscribers = jobs[owner].subscribers;
+    subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), shield), subscribers.end());
     return;
   }
 
-  auto start = clock();
-  auto tlsID = shield->getJunction();
-  pid_t pid = startStorm(tlsID);
+  auto job = jobs.find(shield);
+  if(job==jobs.end()) {
+    return;
+  }
+
+  promoteSubscribers(job->second);
 
-  jobs[shield].pid = pid;
-  jobs[shield].start = start;
+  killJob(job->second);
+  jobs.erase(job);
+  pendingJobs.erase(std::remove(pendingJobs.begin(), pendingJobs.end(), shield), pendingJobs.end());
 
-  while(checkOnStorm(shield)==-1);
+  dispatch();
 }
 
-pid_t STORMConnector::startStorm(std::string &filePrefix) {
+pid_t STORMConnector::startStorm(const std::string &filePrefix, struct STORMJob &job) {
   // std::cout << "START STORM for junction " << junction << std::endl;
-  std::vector<std::string> vecArgs;
-  vecArgs.push_back("--prism");
-  vecArgs.push_back(out_path_ + filePrefix + ".prism");
-  vecArgs.push_back("--prop");
-  vecArgs.push_back(out_path_ + filePrefix + ".props");
-  vecArgs.push_back("--exportscheduler");
-  vecArgs.push_back(out_path_ + filePrefix + ".sched");
-  vecArgs.push_back("--buildstateval");
-  vecArgs.push_back("--buildchoicelab");
-  vecArgs.push_back("--timeout");
-  vecArgs.push_back("180");
-  const char *args[vecArgs.size() + 2];
-
-  args[0] = "/usr/bin/storm";
-  for(uint i = 1; i < vecArgs.size() + 1; i++) {
-    args[i] = vecArgs.at(i - 1).c_str();
-  }
-  args[vecArgs.size() + 1] = nullptr;
-
-  pid_t pid = fork();
-  if(pid==0) {
-    try {
-      int fd = open("STORM.log", O_RDWR | O_CREAT | O_APPEND,
-                    S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH);
-      dup2(fd, STDOUT_FILENO);
-      dup2(fd, STDERR_FILENO);
-    } catch(std::exception &e) {
-      std::cerr << e.what() << std::endl;
+  bool explicitModel = !job.model.explicitModel.labels.empty();
+  std::string modelPath = out_path_ + filePrefix + (explicitModel ? ".drn" : ".prism");
+  std::string schedPath = out_path_ + filePrefix + ".sched";
+
+  auto backend = SynthesisBackend::create(job.model.backend.empty() ? "storm" : job.model.backend);
+  if(backend==nullptr || backend->isInProcess()) {
+    std::cerr << "Synthesis backend " << job.model.backend << " can not run in the job pool\n";
+    return -1;
+  }
+
+  // a parametric program is shared by the jobs of the junction, only the constants differ
+  bool parametric = !explicitModel && !job.model.constants.empty();
+  int modelFd = parametric ? getTemplateFile(job.model.prism) : memfd_create("model", MFD_CLOEXEC);
+  if(!parametric) {
+    job.modelFd = modelFd;
+  }
+  job.schedFd = memfd_create("sched", MFD_CLOEXEC);
+  job.logFd = memfd_create("log", MFD_CLOEXEC);
+  if(modelFd!=-1 && job.schedFd!=-1) {
+    if(!parametric) {
+      // the model is streamed into the memfd, no model string gets built in the process heap
+      std::ofstream model("/proc/self/fd/" + std::to_string(modelFd), std::ios::trunc);
+      writeModel(model, job.model);
+      model.close();
     }
 
-    execv(args[0], (char **)args);
+    modelPath = "/dev/fd/" + std::to_string(modelFd);
+    schedPath = "/dev/fd/" + std::to_string(job.schedFd);
+  } else {
+    modelFd = -1;
+    // no memfd support, use the out/ files
+    closeFiles(job);
+    std::ofstream model(modelPath, std::ios::trunc);
+    writeModel(model, job.model);
+    model.close();
+  }
+
+  std::vector<std::string> vecArgs = backend->getCommand(job.model, modelPath, schedPath);
+  if(gConfig.synthesisMemory > 0) {
+    // prlimit sets the limit and execs STORM in the same process, the limit is in place before STORM starts
+    rlim_t bytes = (rlim_t)gConfig.synthesisMemory*1024*1024;
+    vecArgs.insert(vecArgs.begin(), {PRLIMIT_PATH, "--as=" + std::to_string(bytes), "--"});
+  }
+
+  // the output gets appended to STORM.log after the job finished, only STORM inherits the in-memory files
+  std::vector<int> inheritFds;
+  if(modelFd!=-1) {
+    inheritFds = {modelFd, job.schedFd};
+  }
+  struct processInfo process = spawnProcess(vecArgs, "STORM.log", job.logFd, inheritFds);
+  if(process.pid==-1) {
     perror("STORM NOT STARTED!\n");
+    std::cerr << "Could not start storm process, going to use old strategy (if there is one..)\n";
+    closeFiles(job);
+    return -1;
+  }
+
+  job.pidfd = process.pidfd;
+  return process.pid;
+}
+
+int STORMConnector::getTemplateFile(const std::string &program) {
+  // by hash of the program, every junction has its own program
+  static std::map<std::string, int> templateFiles;
+
+  std::string key = hashString(program);
+  auto file = templateFiles.find(key);
+  if(file!=templateFiles.end()) {
+    return file->second;
+  }
+
+  if(templateFiles.size() >= MAX_TEMPLATE_FILES) {
+    // running STORM processes keep their inherited copy of the descriptor
+    for(const auto &templateFile : templateFiles) {
+      close(templateFile.second);
+    }
+    templateFiles.clear();
+  }
+
+  int fd = memfd_create("template", MFD_CLOEXEC);
+  if(fd==-1) {
+    return -1;
+  }
+  std::ofstream model("/proc/self/fd/" + std::to_string(fd), std::ios::trunc);
+  model << program;
+  model.close();
+
+  templateFiles[key] = fd;
+  return fd;
+}
+
+void STORMConnector::writeModel(std::ostream &out, const struct STORMModel &model) {
+  if(model.explicitModel.labels.empty()) {
+    out << model.prism;
+  } else {
+    ShieldModelGenerator::writeDRNModel(out, model.explicitModel);
+  }
+}
+
+std::string STORMConnector::readScheduler(struct STORMJob &job) {
+  std::string sched;
+
+  if(job.schedFd!=-1) {
+    sched = readFile(job.schedFd);
+  } else {
+    std::ifstream schedFile(out_path_ + job.filePrefix + ".sched");
+    std::stringstream content;
+    content << schedFile.rdbuf();
+    sched = content.str();
+  }
+  closeFiles(job);
+
+  if(gConfig.debugFiles) {
+    std::ofstream schedFile(out_path_ + job.filePrefix + ".sched", std::ios::trunc);
+    schedFile << sched;
+  }
+
+  return sched;
+}
+
+struct SynthesisRecord STORMConnector::measureJob(struct STORMJob &job, int waitStatus) {
+  struct SynthesisRecord record;
+  record.modelKey = job.model.key;
+  record.backend = job.model.backend.empty() ? "storm" : job.model.backend;
+  record.speculative = job.requester!=nullptr;
+  record.predictedStates = job.model.states;
+  record.wallTime = std::chrono::duration<double>(job.end - job.start).count();
+  record.cpuTime = job.usage.ru_utime.tv_sec + job.usage.ru_utime.tv_usec*1e-6
+      + job.usage.ru_stime.tv_sec + job.usage.ru_stime.tv_usec*1e-6;
+  record.peakRSS = job.usage.ru_maxrss;
+
+  if(job.timedOut) {
+    record.outcome = "timeout";
+  } else if(WIFEXITED(waitStatus)) {
+    record.exitCode = WEXITSTATUS(waitStatus);
+    record.outcome = record.exitCode==0 ? "success" : "failed";
+  } else if(WIFSIGNALED(waitStatus)) {
+    record.outcome = "signal";
+  } else {
+    record.outcome = "failed";
+  }
+
+  if(job.logFd!=-1) {
+    std::string output = readFile(job.logFd);
+    SynthesisTelemetry::parseModelSize(output, record);
+
+    std::ofstream log("STORM.log", std::ios::app);
+    log << output;
+  }
+
+  return record;
+}
+
+std::string STORMConnector::readFile(int fd) {
+  std::string content;
+  char buffer[1 << 16];
+  ssize_t size;
+  lseek(fd, 0, SEEK_SET);
+  while((size = read(fd, buffer, sizeof(buffer))) > 0) {
+    content.append(buffer, size);
+  }
+  return content;
+}
+
+void STORMConnector::closeFiles(struct STORMJob &job) {
+  if(job.socketFd!=-1) {
+    close(job.socketFd);
+    job.socketFd = -1;
+  }
+  if(job.modelFd!=-1) {
+    close(job.modelFd);
+    job.modelFd = -1;
+  }
+  if(job.schedFd!=-1) {
+    close(job.schedFd);
+    job.schedFd = -1;
+  }
+  if(job.logFd!=-1) {
+    close(job.logFd);
+    job.logFd = -1;
+  }
+}
+
+void STORMConnector::dispatch() {
+  size_t running = 0;
+  for(const auto &job : jobs) {
+    if(job.second.pid!=-1) {
+      running++;
+    }
+  }
+  for(const auto &job : speculativeJobs) {
+    if(job.second.pid!=-1) {
+      running++;
+    }
+  }
+
+  // regular jobs take the slots of speculative jobs, which get queued again
+  for(auto &job : speculativeJobs) {
+    if(running < gConfig.synthesisJobs || pendingJobs.empty()) {
+      break;
+    }
+
+    if(job.second.pid!=-1) {
+      killJob(job.second);
+      job.second.pid = -1;
+      pendingSpeculativeJobs.push_front(job.first);
+      running--;
+    }
+  }
 
-  } else if(pid==-1) {
-    std::cerr << "Could not fork to start storm process, going to use old strategy (if there is one..)\n";
-    return pid;
+  std::vector<Shield *> failed;
+  std::vector<std::pair<std::string, Shield *>> failedSpeculations;
+  while(!pendingJobs.empty() && running < gConfig.synthesisJobs) {
+    // most urgent job first, FIFO on ties
+    auto next = pendingJobs.begin();
+    float priority = getPriority(*next);
+    for(auto pending = pendingJobs.begin() + 1; pending!=pendingJobs.end(); pending++) {
+      float pendingPriority = getPriority(*pending);
+      if(pendingPriority > priority) {
+        next = pending;
+        priority = pendingPriority;
+      }
+    }
+
+    Shield *shield = *next;
+    pendingJobs.erase(next);
+
+    // the solver of the current owner, a promoted subscriber does not share the solver of the old owner
+    if(isInProcess(jobs[shield].model.backend)) {
+      jobs[shield].solver = shield->getSolver();
+    }
+    if(!startJob(shield->getJunction(), jobs[shield])) {
+      // keep the old strategy, the owner and the subscribers get notified below
+      failed.push_back(shield);
+      failed.insert(failed.end(), jobs[shield].subscribers.begin(), jobs[shield].subscribers.end());
+      jobs.erase(shield);
+      continue;
+    }
+    running++;
+  }
+
+  while(pendingJobs.empty() && !pendingSpeculativeJobs.empty() && running < gConfig.synthesisJobs) {
+    std::string modelKey = pendingSpeculativeJobs.front();
+    pendingSpeculativeJobs.pop_front();
+
+    auto &job = speculativeJobs[modelKey];
+    if(!startJob(getSpeculativePrefix(modelKey), job)) {
+      failedSpeculations.emplace_back(modelKey, job.requester);
+      for(auto subscriber : job.subscribers) {
+        failedSpeculations.emplace_back(modelKey, subscriber);
+      }
+      speculativeJobs.erase(modelKey);
+      continue;
+    }
+    running++;
+  }
+
+  // the callbacks can queue new jobs, the pool is consistent at this point
+  for(auto shield : failed) {
+    shield->synthesisFailureCallback();
+  }
+  for(const auto &speculation : failedSpeculations) {
+    speculation.second->shareSpeculativeFailureCallback(speculation.first);
+  }
+}
+
+bool STORMConnector::isInProcess(const std::string &backend) {
+  auto synthesisBackend = SynthesisBackend::create(backend);
+  return synthesisBackend!=nullptr && synthesisBackend->isInProcess();
+}
+
+float STORMConnector::getPriority(Shield *shield) const {
+  float priority = shield->getSynthesisPriority();
+  auto job = jobs.find(shield);
+  if(job!=jobs.end()) {
+    for(auto subscriber : job->second.subscribers) {
+      priority = std::max(priority, subscriber->getSynthesisPriority());
+    }
+  }
+  return priority;
+}
+
+bool STORMConnector::startJob(const std::string &filePrefix, struct STORMJob &job) {
+  job.filePrefix = filePrefix;
+  job.start = std::chrono::steady_clock::now();
+  job.end = std::chrono::steady_clock::time_point();
+  // STORM stops itself after the timeout, the deadline is the hard limit
+  job.deadline = job.start + std::chrono::seconds(gConfig.synthesisTimeout + SYNTHESIS_KILL_GRACE);
+
+  if(job.solver!=nullptr) {
+    // the thread gets its own copies, the job may move in the pool while it runs
+    auto solver = job.solver;
+    auto model = job.model.explicitModel;
+    int eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    try {
+      job.solution = std::async(std::launch::async, [solver, model, eventFd]() {
+        struct NativeSolution solution;
+        struct timespec cpuStart{}, cpuEnd{};
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuStart);
+        solution.solved = solver->solve(model, solution.table);
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuEnd);
+        solution.cpuTime = (double)(cpuEnd.tv_sec - cpuStart.tv_sec) + (cpuEnd.tv_nsec - cpuStart.tv_nsec)/1e9;
+        solution.states = solution.solved ? solver->getModelStates() : 0;
+
+        if(eventFd!=-1) {
+          uint64_t finished = 1;
+          if(write(eventFd, &finished, sizeof(finished))==-1) {
+            perror("Could not signal the finished solver");
+          }
+        }
+        return solution;
+      });
+    } catch(std::system_error &e) {
+      std::cerr << "Could not start the solver for " << filePrefix << ": " << e.what() << "\n";
+      if(eventFd!=-1) {
+        close(eventFd);
+      }
+      return false;
+    }
+    job.eventFd = eventFd;
+    job.pid = 0;
+    return true;
+  }
+
+  if(!gConfig.synthdSocket.empty()) {
+    if(sendJob(job)) {
+      job.pid = 0;
+      return true;
+    }
+    std::cerr << "Synthesis worker " << gConfig.synthdSocket << " not reachable, start STORM for "
+              << filePrefix << " locally\n";
+  }
+
+  job.pid = startStorm(filePrefix, job);
+  return job.pid!=-1;
+}
+
+bool STORMConnector::sendJob(struct STORMJob &job) {
+  struct sockaddr_un address{};
+  if(gConfig.synthdSocket.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, gConfig.synthdSocket.c_str(), sizeof(address.sun_path) - 1);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if(fd==-1) {
+    return false;
+  }
+  if(connect(fd, (struct sockaddr *)&address, sizeof(address))==-1) {
+    close(fd);
+    return false;
+  }
+
+  std::string request = encodeRequest(job.model);
+  size_t written = 0;
+  while(written < request.size()) {
+    ssize_t size = send(fd, request.data() + written, request.size() - written, MSG_NOSIGNAL);
+    if(size==-1 && errno==EINTR) {
+      continue;
+    }
+    if(size==-1) {
+      close(fd);
+      return false;
+    }
+    written += size;
+  }
+
+  // the response is collected without blocking
+  fcntl(fd, F_SETFL, O_NONBLOCK);
+  job.socketFd = fd;
+  job.response.clear();
+  return true;
+}
+
+pid_t STORMConnector::collectJob(const std::string &filePrefix, struct STORMJob &job, int &waitStatus) {
+  if(job.solution.valid()) {
+    // the solver stops itself after the time limit, there is no deadline to enforce
+    if(job.solution.wait_for(std::chrono::seconds(0))!=std::future_status::ready) {
+      return 0;
+    }
+
+    waitStatus = 0;
+    stampExit(job);
+    if(job.eventFd!=-1) {
+      close(job.eventFd);
+      job.eventFd = -1;
+    }
+    return 1;
+  }
+
+  if(job.socketFd!=-1) {
+    char buffer[1 << 16];
+    ssize_t size;
+    while((size = read(job.socketFd, buffer, sizeof(buffer))) > 0) {
+      job.response.append(buffer, size);
+    }
+
+    bool finished = job.response.find('\n')!=std::string::npos || size==0
+        || (errno!=EAGAIN && errno!=EWOULDBLOCK && errno!=EINTR);
+    if(!finished) {
+      if(std::chrono::steady_clock::now() < job.deadline) {
+        return 0;
+      }
+
+      // closing the connection cancels the job in the worker
+      std::cerr << "Synthesis worker job for " << filePrefix << " exceeded the deadline\n";
+      job.timedOut = true;
+    }
+
+    waitStatus = 0;
+    stampExit(job);
+    return 1;
+  }
+
+  pid_t w = wait4(job.pid, &waitStatus, WNOHANG, &job.usage);
+  if(w==0) {
+    if(std::chrono::steady_clock::now() < job.deadline) {
+      // still running
+      return 0;
+    }
+
+    std::cerr << "Storm PID " << job.pid << " for " << filePrefix << " exceeded the deadline\n";
+    kill(job.pid, SIGKILL);
+    job.timedOut = true;
+    w = wait4(job.pid, &waitStatus, 0, &job.usage);
+  }
+
+  stampExit(job);
+  if(job.pidfd!=-1) {
+    close(job.pidfd);
+    job.pidfd = -1;
+  }
+  return w;
+}
+
+bool STORMConnector::finishJob(const std::string &filePrefix, struct STORMJob &job, int waitStatus,
+                               struct SynthesisRecord &record, StrategyTable &table) {
+  table.clear();
+
+  if(job.solution.valid()) {
+    struct NativeSolution solution = job.solution.get();
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+
+    record = SynthesisRecord();
+    record.modelKey = job.model.key;
+    record.backend = job.model.backend;
+    record.predictedStates = job.model.states;
+    record.wallTime = std::chrono::duration<double>(job.end - job.start).count();
+    record.cpuTime = solution.cpuTime;
+    record.peakRSS = usage.ru_maxrss; // of the simulation process
+    record.outcome = solution.solved ? "success" : "failed";
+    record.states = solution.states;
+    table = std::move(solution.table);
+    job.solver.reset();
+    return solution.solved;
+  }
+
+  if(job.socketFd!=-1) {
+    if(job.timedOut || !decodeResponse(job.response, record, table)) {
+      record = SynthesisRecord();
+      record.outcome = job.timedOut ? "timeout" : "failed";
+      record.wallTime = std::chrono::duration<double>(job.end - job.start).count();
+      table.clear();
+    }
+    record.modelKey = job.model.key;
+    record.backend = "synthd";
+    record.speculative = job.requester!=nullptr;
+    record.predictedStates = job.model.states;
+    closeFiles(job);
+    return record.outcome=="success";
+  }
+
+  record = measureJob(job, waitStatus);
+  std::string sched = readScheduler(job);
+  if(record.outcome!="success") {
+    return false;
+  }
+
+  if(!parseScheduler(sched, job.model, table)) {
+    std::cerr << "Malformed scheduler for " << filePrefix << std::endl;
+    record.outcome = "error";
+    table.clear();
+    return false;
+  }
+  return true;
+}
+
+bool STORMConnector::parseScheduler(const std::string &sched, const struct STORMModel &model, StrategyTable &table) {
+  Strategy strategy(model.key, model.labels);
+  std::istringstream schedStream(sched);
+  bool parsed = true;
+  try {
+    if(model.explicitModel.labels.empty()) {
+      strategy.loadSched(schedStream);
+    } else {
+      parsed = strategy.loadExplicitSched(schedStream, model.explicitModel.stateSpace,
+                                          model.explicitModel.actionLabels.size());
+    }
+  } catch(std::exception &e) {
+    parsed = false;
+  }
+  table = strategy.getStrategyTable();
+  return parsed;
+}
+
+void STORMConnector::killJob(struct STORMJob &job) {
+  if(job.solution.valid()) {
+    job.solution.wait();
+    job.solution = std::future<struct NativeSolution>();
+  }
+  if(job.eventFd!=-1) {
+    close(job.eventFd);
+    job.eventFd = -1;
+  }
+  job.solver.reset();
+  if(job.pid > 0) {
+    kill(job.pid, SIGKILL);
+    waitpid(job.pid, nullptr, 0);
+  }
+  if(job.pidfd!=-1) {
+    close(job.pidfd);
+    job.pidfd = -1;
+  }
+  closeFiles(job);
+}
+
+std::string STORMConnector::getSpeculativePrefix(const std::string &modelKey) {
+  return speculativeJobs[modelKey].requester->getJunction() + "_" + modelKey;
+}
+
+Shield *STORMConnector::findOwner(Shield *shield) const {
+  for(const auto &job : jobs) {
+    const auto &subscribers = job.second.subscribers;
+    if(std::find(subscribers.begin(), subscribers.end(), shield)!=subscribers.end()) {
+      return job.first;
+    }
+  }
+  return nullptr;
+}
+
+void STORMConnector::promoteSubscribers(struct STORMJob &job) {
+  if(job.subscribers.empty()) {
+    if(!job.speculativeSubscribers.empty() && speculativeJobs.find(job.model.key)==speculativeJobs.end()) {
+      auto &speculative = speculativeJobs[job.model.key];
+      speculative.model = job.model;
+      speculative.requester = job.speculativeSubscribers.front();
+      speculative.subscribers.assign(job.speculativeSubscribers.begin() + 1, job.speculativeSubscribers.end());
+      pendingSpeculativeJobs.push_back(job.model.key);
+    }
+    job.speculativeSubscribers.clear();
+    return;
+  }
+
+  Shield *owner = job.subscribers.front();
+  auto &promoted = jobs[owner];
+  promoted.model = job.model;
+  promoted.subscribers.assign(job.subscribers.begin() + 1, job.subscribers.end());
+  promoted.speculativeSubscribers = std::move(job.speculativeSubscribers);
+  job.subscribers.clear();
+  job.speculativeSubscribers.clear();
+
+  // the subscribers waited already, start them first
+  pendingJobs.push_front(owner);
+}
+
+void STORMConnector::waitForAnyJob(int timeout) {
+  std::vector<struct pollfd> fds;
+  std::vector<struct STORMJob *> polled;
+  for(auto &job : jobs) {
+    if(job.second.socketFd!=-1) {
+      fds.push_back({job.second.socketFd, POLLIN, 0});
+    } else if(job.second.eventFd!=-1) {
+      fds.push_back({job.second.eventFd, POLLIN, 0});
+    } else if(job.second.pid!=-1 && job.second.pidfd==-1) {
+      // no process file descriptor available, fall back to short sleeps
+      usleep(1000);
+      return;
+    } else if(job.second.pidfd!=-1) {
+      fds.push_back({job.second.pidfd, POLLIN, 0});
+    } else {
+      continue;
+    }
+    polled.push_back(&job.second);
+  }
+  for(auto &job : speculativeJobs) {
+    if(job.second.socketFd!=-1) {
+      fds.push_back({job.second.socketFd, POLLIN, 0});
+    } else if(job.second.pidfd!=-1) {
+      fds.push_back({job.second.pidfd, POLLIN, 0});
+    } else {
+      continue;
+    }
+    polled.push_back(&job.second);
   }
 
-  return pid;
+  if(!fds.empty() && ::poll(fds.data(), fds.size(), timeout) > 0) {
+    for(size_t i = 0; i < fds.size(); i++) {
+      if(fds[i].revents!=0) {
+        stampExit(*polled[i]);
+      }
+    }
+  }
+}
+
+void STORMConnector::stampExit(struct STORMJob &job) {
+  if(job.end==std::chrono::steady_clock::time_point()) {
+    job.end = std::chrono::steady_clock::now();
+  }
 }
 
 int STORMConnector::checkOnStorm(Shield *shield) {
@@ -72,39 +857,102 @@ int STORMConnector::checkOnStorm(Shield *shield) {
   }
 
   pid_t pid = jobs[shield].pid;
-  clock_t start = jobs[shield].start;
 
   int waitStatus;
-  pid_t w = waitpid(pid, &waitStatus, WUNTRACED | WCONTINUED);
-  if(w==-1) {
-    std::cerr << "Could not wait for process\n";
-    return 1;
+  pid_t w = collectJob(shield->getJunction(), jobs[shield], waitStatus);
+  if(w==0) {
+    return -1;
+  }
+
+  struct SynthesisRecord record;
+  StrategyTable table;
+  bool solved = false;
+  if(w!=-1) {
+    solved = finishJob(shield->getJunction(), jobs[shield], waitStatus, record, table);
+    record.junction = shield->getJunction();
+    SynthesisTelemetry::instance().record(record);
+    BackendCalibration::instance().record(jobs[shield].model.backend, jobs[shield].model.states, solved,
+                                          record.wallTime);
+  } else {
+    closeFiles(jobs[shield]);
   }
-  if(WIFEXITED(waitStatus) && waitStatus==0) {
+  float elapsed = (float)record.wallTime;
+
+  std::vector<Shield *> subscribers = jobs[shield].subscribers;
+  std::vector<Shield *> speculativeSubscribers = jobs[shield].speculativeSubscribers;
+  struct STORMModel model = std::move(jobs[shield].model);
+  jobs.erase(shield);
+
+  if(solved) {
     // std::cout << "Storm PID " << pid << " for " << junction << " success after "
-    //   << float(clock() - start)/CLOCKS_PER_SEC << std::endl;
+    //   << elapsed << std::endl;
+
+    // the throughput estimates STORM, the in-process solver has its own speed
+    if(model.states > 0 && elapsed > 0. && !isInProcess(model.backend)) {
+      double sample = model.states/elapsed;
+      throughput = throughput > 0. ? 0.8*throughput + 0.2*sample : sample;
+    }
 
-    shield->updateStrategyCallback();
-    jobs.erase(shield);
+    shield->updateStrategyCallback(table, model.key);
+    for(auto subscriber : subscribers) {
+      subscriber->shareStrategyCallback(table);
+    }
+    for(auto subscriber : speculativeSubscribers) {
+      subscriber->shareSpeculativeStrategyCallback(model.key, table);
+    }
     return 0;
-  } else if(waitStatus!=0) {
-    std::cerr << "Storm PID " << pid << " for " << shield->getJunction() <<
-              " did not success after " << float(clock() - start)/CLOCKS_PER_SEC << std::endl;
-    // avoid state space growth
-    shield->lockStateSpaceSize();
-    jobs.erase(shield);
-    return 1;
-  } else if(WIFSIGNALED(waitStatus)) {
+  } else if(w==-1) {
+    std::cerr << "Could not wait for process\n";
+  } else if(pid > 0 && WIFSIGNALED(waitStatus)) {
     printf("Storm PID %d killed by signal %d\n", pid, WTERMSIG(waitStatus));
-    jobs.erase(shield);
-    return 1;
-  } else if(WIFSTOPPED(waitStatus)) {
-    printf("Storm PID %d stopped by signal %d\n", pid, WSTOPSIG(waitStatus));
-    jobs.erase(shield);
-    return 1;
-  } else if(WIFCONTINUED(waitStatus)) {
-    //printf("continued\n");
+  } else {
+    std::cerr << (isInProcess(model.backend) ? "Solver for " : "Storm for ") << shield->getJunction()
+              << " (" << record.outcome << ")"
+              << " did not success after " << elapsed << "s" << std::endl;
   }
 
-  return -1;
+  // fall back to the old strategy and back off the state space growth
+  shield->synthesisFailureCallback();
+  for(auto subscriber : subscribers) {
+    subscriber->synthesisFailureCallback();
+  }
+  for(auto subscriber : speculativeSubscribers) {
+    subscriber->shareSpeculativeFailureCallback(model.key);
+  }
+  return 1;
+}
+
+void STORMConnector::checkOnSpeculativeStorm(const std::string &modelKey) {
+  auto &job = speculativeJobs[modelKey];
+  std::string filePrefix = getSpeculativePrefix(modelKey);
+
+  int waitStatus;
+  pid_t w = collectJob(filePrefix, job, waitStatus);
+  if(w==0) {
+    return;
+  }
+
+  struct SynthesisRecord record;
+  StrategyTable table;
+  bool solved = false;
+  if(w!=-1) {
+    solved = finishJob(filePrefix, job, waitStatus, record, table);
+    record.junction = job.requester->getJunction();
+    SynthesisTelemetry::instance().record(record);
+  } else {
+    closeFiles(job);
+  }
+
+  Shield *requester = job.requester;
+  std::vector<Shield *> subscribers = job.subscribers;
+  speculativeJobs.erase(modelKey);
+
+  subscribers.insert(subscribers.begin(), requester);
+  for(auto subscriber : subscribers) {
+    if(solved) {
+      subscriber->shareSpeculativeStrategyCallback(modelKey, table);
+    } else {
+      subscriber->shareSpeculativeFailureCallback(modelKey);
+    }
+  }
 }
@@ -25,56 +25,42 @@ SUMOConnector::SUMOConnector(const std::string &config,
 }
 
 void SUMOConnector::boot() {
-  pid_t pid = fork();
-  if(pid==-1) {
-    std::cerr << "Could not fork to start SUMO, aborting\n";
-    return;
+  std::vector<std::string> args;
+  if(useGui) {
+    args.emplace_back("/usr/bin/sumo-gui");
+  } else {
+    args.emplace_back("/usr/bin/sumo");
   }
-  if(pid==0) {
 
-    std::string argPort = std::to_string(port_);
-    std::string argWindowSize = "--window-size=";
-    std::string argWindowPos = "--window-pos=";
-
-    std::vector<char *> args;
-    if(useGui) {
-      args.push_back(const_cast<char *>("/usr/bin/sumo-gui"));
-    } else {
-      args.push_back(const_cast<char *>("/usr/bin/sumo"));
-    }
-
-    args.push_back(const_cast<char *>("-c"));
-    args.push_back(const_cast<char *>(config_.c_str()));
-    args.push_back(const_cast<char *>("--remote-port"));
-    args.push_back(const_cast<char *>(argPort.c_str()));
-    args.push_back(const_cast<char *>("--start"));
-    args.push_back(const_cast<char *>("-Q"));
-    args.push_back(const_cast<char *>("--no-step-log=true"));
-    args.push_back(const_cast<char *>("--time-to-teleport=-1"));
-
-    if(useGui && sumoGuiWindowSize.first!=-1 && sumoGuiWindowSize.second!=-1) {
-      argWindowSize += std::to_string(sumoGuiWindowSize.first) + "," + std::to_string(sumoGuiWindowSize.second);
-      args.push_back(const_cast<char *>(argWindowSize.c_str()));
-    }
-
-    if(useGui && sumoGuiWindowPos.first!=-1 && sumoGuiWindowPos.second!=-1) {
-      argWindowPos += std::to_string(sumoGuiWindowPos.first) + "," + std::to_string(sumoGuiWindowPos.second);
-      args.push_back(const_cast<char *>(argWindowPos.c_str()));
-    }
-
-    args.push_back(NULL);
-
-    int fd = open("stderr.log", O_RDWR | O_CREAT | O_APPEND,
-                  S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH);
+  args.emplace_back("-c");
+  args.push_back(config_);
+  args.emplace_back("--remote-port");
+  args.push_back(std::to_string(port_));
+  args.emplace_back("--start");
+  args.emplace_back("-Q");
+  args.emplace_back("--no-step-log=true");
+  args.emplace_back("--time-to-teleport=-1");
+
+  if(useGui && sumoGuiWindowSize.first!=-1 && sumoGuiWindowSize.second!=-1) {
+    args.push_back("--window-size=" + std::to_string(sumoGuiWindowSize.first) + ","
+                       + std::to_string(sumoGuiWindowSize.second));
+  }
 
-    dup2(fd, STDOUT_FILENO);
-    dup2(fd, STDERR_FILENO);
+  if(useGui && sumoGuiWindowPos.first!=-1 && sumoGuiWindowPos.second!=-1) {
+    args.push_back("--window-pos=" + std::to_string(sumoGuiWindowPos.first) + ","
+                       + std::to_string(sumoGuiWindowPos.second));
+  }
 
-    execv(args[0], args.data());
+  struct processInfo process = spawnProcess(args, "stderr.log");
+  if(process.pid==-1) {
     perror("SUMO NOT STARTED!\n");
-  } else {
-    pid_ = pid;
+    return;
   }
+  if(process.pidfd!=-1) {
+    ::close(process.pidfd);
+  }
+
+  pid_ = process.pid;
 }
 
 void SUMOConnector::connect() {
@@ -1,11 +1,16 @@
 #include <fstream>
 #include <unistd.h>
 #include <iomanip>
+#include <sstream>
 #include <iostream>
 #include <cassert>
+#include <algorithm>
+#include <limits>
 
 #include "Shield.h"
 #include "STORMConnector.h"
+#include "StrategyCache.h"
+#include "SynthesisBackend.h"
 #include "Util.h"
 
 Shield::Shield(const std::string &tlsID, const Environment &environment, const Controller &controller)
@@ -14,17 +19,7 @@ Shield::Shield(const std::string &tlsID, const Environment &environment, const C
       strategy(tlsID, environment.getStateSpaceLabels()) {
   setFilename(out_path_ + tlsID + ".json");
 
-  // default model
-  setModelType("mdp");
-  std::vector<std::string> module;
-  module.push_back("Rmin=? [ LRA ]");
-  setProperties(module);
-
-  createPRISMArbiter(controller);
-  createPRISMController(controller);
-  createPRISMShield(controller);
-  createPRISMRewards(controller);
-  createPRISMEnvironment(environment);
+  createDefaultModel(environment, controller);
 
   environment.check();
   controller.check();
@@ -66,9 +61,34 @@ float Shield::getStateProbabilitiesDelta() const {
 }
 
 int Shield::getShieldGeneration() const {
+  if(!subShields.empty()) {
+    int subGeneration = std::numeric_limits<int>::max();
+    for(const auto &subShield : subShields) {
+      subGeneration = std::min(subGeneration, subShield->getShieldGeneration());
+    }
+    return subGeneration;
+  }
+
   return generation;
 }
 
+float Shield::getSynthesisPriority() const {
+  if(generation < 0) {
+    return std::numeric_limits<float>::max();
+  }
+
+  // the shield clips halting numbers beyond the strategy bounds
+  auto haltingNumbers = environment.getHaltingNumbers();
+  auto strategyStateSpace = strategy.getStateSpace();
+  int overflow = 0;
+  for(size_t i = 0; i < haltingNumbers.size() && i < strategyStateSpace.size(); i++) {
+    overflow += std::max(0, haltingNumbers[i] - strategyStateSpace[i]);
+  }
+
+  return PRIORITY_WEIGHT_PROBABILITY*probDelta + PRIORITY_WEIGHT_STATE*stateDelta
+      + PRIORITY_WEIGHT_OVERFLOW*overflow + PRIORITY_WEIGHT_AGE*strategyAge;
+}
+
 void Shield::printConfig() {
   std::cout << "PRINT Config:\n";
   std::cout << tlsID << std::endl;
@@ -85,44 +105,473 @@ std::string Shield::logConfig() {
   log << "\t" << environment.getStateSpaceString() << std::endl;
   log << "\t" << controller.getActionSpaceString() << std::endl;
 
+  if(gConfig.quantization > 0.) {
+    auto environmentProbabilities = environment.getProbabilities();
+    auto controllerProbabilities = controller.getProbabilities();
+    log << "\tQuantization Error = "
+        << getDelta(quantizePMF(environmentProbabilities), environmentProbabilities) << " (environment), "
+        << getDelta(quantizePMF(controllerProbabilities), controllerProbabilities) << " (controller)"
+        << std::endl;
+  }
+
   return log.str();
 }
 
-void Shield::createStrategy() {
+Shield::~Shield() {
+  STORMConnector::instance().cancelStrategyUpdate(this);
+  STORMConnector::instance().cancelSpeculativeUpdates(this);
+}
+
+std::vector<std::vector<size_t>> Shield::getLaneGroups(const std::vector<std::string> &labels,
+                                                       const std::vector<std::vector<std::string>> &ways,
+                                                       size_t maxLanes) {
+  // number of phases serving both lanes
+  std::vector<std::vector<int>> interaction(labels.size(), std::vector<int>(labels.size(), 0));
+  for(const auto &way : ways) {
+    std::vector<size_t> lanes;
+    for(const auto &w : way) {
+      auto lane = std::find(labels.begin(), labels.end(), w);
+      if(lane!=labels.end()) {
+        lanes.push_back(lane - labels.begin());
+      }
+    }
+    for(auto a : lanes) {
+      for(auto b : lanes) {
+        if(a!=b) {
+          interaction[a][b]++;
+        }
+      }
+    }
+  }
+
+  std::vector<std::vector<size_t>> groups;
+  for(size_t i = 0; i < labels.size(); i++) {
+    groups.push_back({i});
+  }
+
+  // merge the groups with the most shared phases first, the first pair wins on ties
+  while(true) {
+    int best = 0;
+    size_t bestA = 0;
+    size_t bestB = 0;
+    for(size_t a = 0; a < groups.size(); a++) {
+      for(size_t b = a + 1; b < groups.size(); b++) {
+        if(groups[a].size() + groups[b].size() > maxLanes) {
+          continue;
+        }
+
+        int shared = 0;
+        for(auto i : groups[a]) {
+          for(auto j : groups[b]) {
+            shared += interaction[i][j];
+          }
+        }
+        if(shared > best) {
+          best = shared;
+          bestA = a;
+          bestB = b;
+        }
+      }
+    }
+
+    if(best==0) {
+      break;
+    }
+    groups[bestA].insert(groups[bestA].end(), groups[bestB].begin(), groups[bestB].end());
+    std::sort(groups[bestA].begin(), groups[bestA].end());
+    groups.erase(groups.begin() + bestB);
+  }
+
+  return groups;
+}
+
+bool Shield::split() {
+  if(!subShields.empty()) {
+    return true;
+  }
+
+  auto labels = environment.getStateSpaceLabels();
+  if(gConfig.subShieldLanes==0 || labels.size() <= gConfig.subShieldLanes) {
+    return false;
+  }
+
+  auto ways = controller.getActionSpaceWays();
+  laneGroups = getLaneGroups(labels, ways, gConfig.subShieldLanes);
+
+  auto probabilities = environment.getProbabilities();
+  auto weights = environment.getWeights();
+  auto stateSpace = environment.getStateSpace();
+  for(size_t g = 0; g < laneGroups.size(); g++) {
+    const auto &group = laneGroups[g];
+
+    std::vector<std::string> groupLabels;
+    std::vector<float> groupProbabilities;
+    float sum = 0.;
+    for(auto i : group) {
+      groupLabels.push_back(labels[i]);
+      groupProbabilities.push_back(probabilities[i]);
+      sum += probabilities[i];
+    }
+    for(auto &p : groupProbabilities) {
+      p = sum > 0. ? p/sum : 1.f/(float)group.size();
+    }
+
+    // all phases, a phase serves only the lanes of the group (maybe none)
+    std::vector<std::vector<std::string>> groupWays;
+    for(const auto &way : ways) {
+      std::vector<std::string> groupWay;
+      for(const auto &w : way) {
+        if(std::find(groupLabels.begin(), groupLabels.end(), w)!=groupLabels.end()) {
+          groupWay.push_back(w);
+        }
+      }
+      groupWays.push_back(groupWay);
+    }
+
+    Environment groupEnvironment(groupLabels, groupProbabilities, project(weights, group), project(stateSpace, group));
+    Controller groupController(controller.getActionSpace(), controller.getProbabilities(), groupWays);
+    subShields.emplace_back(new Shield(tlsID + "_sub" + std::to_string(g), groupEnvironment, groupController));
+  }
+
+  std::cout << tlsID << ": " << labels.size() << " lanes split into " << laneGroups.size() << " sub-shields\n";
+  return true;
+}
+
+std::vector<int> Shield::project(const std::vector<int> &values, const std::vector<size_t> &group) {
+  std::vector<int> groupValues;
+  for(auto i : group) {
+    groupValues.push_back(values[i]);
+  }
+  return groupValues;
+}
+
+int Shield::getComposedAction(int currentAction) {
+  auto haltingNumbers = environment.getHaltingNumbers();
+
+  std::map<int, int> votes;
+  for(size_t g = 0; g < subShields.size(); g++) {
+    int action = subShields[g]->getNextAction(currentAction);
+    if(action==-1) {
+      continue;
+    }
+
+    int pressure = 1;
+    for(auto i : laneGroups[g]) {
+      pressure += haltingNumbers[i];
+    }
+    votes[action] += pressure;
+  }
+
+  int shieldAction = -1;
+  int best = 0;
+  for(const auto &vote : votes) {
+    if(vote.second > best || (vote.second==best && vote.first==currentAction)) {
+      shieldAction = vote.first;
+      best = vote.second;
+    }
+  }
+
+  return shieldAction;
+}
+
+bool Shield::createStrategy(bool blocking) {
+  if(split()) {
+    // the sub-shields synthesize in parallel
+    bool created = true;
+    for(const auto &subShield : subShields) {
+      created = subShield->createStrategy(false) && created;
+    }
+    if(blocking) {
+      for(const auto &subShield : subShields) {
+        STORMConnector::instance().waitForStrategyUpdate(subShield.get());
+      }
+    }
+    return created;
+  }
+
+  // a running job can not take a new model, wait for it.
+  if(STORMConnector::instance().isRunning(this)) {
+    if(!blocking) {
+      return false;
+    }
+    STORMConnector::instance().waitForStrategyUpdate(this);
+  }
+
+  struct STORMModel stormModel = getSTORMModel(environment);
+  const std::string &modelKey = stormModel.key;
+
+  if(gConfig.debugFiles) {
+    createPRISMFile(stormModel.constants.empty() ? stormModel.prism : getPRISMModel(environment, controller));
+    createPropFile();
+    if(!stormModel.explicitModel.labels.empty()) {
+      createDRNFile(stormModel.explicitModel);
+    }
+  }
+
+  StrategyTable table;
+  if(!gConfig.noStrategyCache && StrategyCache::instance().lookup(modelKey, table)) {
+    // model already solved, a queued job would load an outdated model
+    STORMConnector::instance().cancelStrategyUpdate(this);
+    getStrategy()->setStrategyTable(table);
+    installStrategy();
+    return true;
+  }
+
+  if(installSpeculation()) {
+    return true;
+  }
+
+  std::string backend = BackendCalibration::instance().select(stormModel.states);
+  // unknown backends fail in the job pool
+  auto synthesisBackend = SynthesisBackend::create(backend);
+  if(synthesisBackend!=nullptr && synthesisBackend->isInProcess() && stormModel.explicitModel.labels.empty()) {
+    // the solver gets the parameters of the model, it runs on a worker thread
+    stormModel.explicitModel = getExplicitModel(environment, controller);
+  }
+
+  stormModel.backend = backend;
+  STORMConnector::instance().startStrategyUpdate(this, stormModel);
+  if(blocking) {
+    STORMConnector::instance().waitForStrategyUpdate(this);
+  }
+
+  return true;
+}
+
+bool Shield::loadCachedStrategy() {
+  if(split()) {
+    bool loaded = true;
+    for(const auto &subShield : subShields) {
+      loaded = subShield->loadCachedStrategy() && loaded;
+    }
+    return loaded;
+  }
+
+  if(gConfig.noStrategyCache) {
+    return false;
+  }
+
+  StrategyTable table;
+  if(!StrategyCache::instance().lookup(getSTORMModel(environment).key, table)) {
+    return false;
+  }
+
+  getStrategy()->setStrategyTable(table);
+  installStrategy();
+  return true;
+}
+
+struct STORMModel Shield::getSTORMModel(const Environment &modelEnvironment) {
+  struct STORMModel stormModel;
+  if(gConfig.parametricModel) {
+    stormModel.prism = getPRISMTemplate(modelEnvironment, controller);
+    stormModel.constants = getPRISMConstants(modelEnvironment, controller);
+    // the key covers the values, the program alone is the same for all updates
+    stormModel.key = getModelKey(stormModel.prism + "// " + stormModel.constants,
+                                 modelEnvironment.getStateSpaceLabels());
+  } else {
+    stormModel.prism = getPRISMModel(modelEnvironment, controller);
+    stormModel.key = getModelKey(stormModel.prism, modelEnvironment.getStateSpaceLabels());
+  }
+  stormModel.properties = getPropertiesString();
+  stormModel.labels = modelEnvironment.getStateSpaceLabels();
+  stormModel.states = getModelSize(modelEnvironment.getStateSpace(), controller.getActionSpace().size()).states;
+  // the DRN export follows the default modules, modules of a config file need the PRISM program
+  if(gConfig.explicitModel && hasDefaultModel(modelEnvironment, controller)) {
+    stormModel.explicitModel = getExplicitModel(modelEnvironment, controller);
+  }
+
+  return stormModel;
+}
+
+void Shield::speculate() {
+  if(!gConfig.speculative || gConfig.backend=="native" || backoff > 0) {
+    return;
+  }
+
+  auto stateSpace = environment.getStateSpace();
+  auto probabilities = quantizePMF(environment.getProbabilities());
+
+  // drop speculations the shield grew past or with outdated probabilities
+  for(auto speculation = speculations.begin(); speculation!=speculations.end();) {
+    bool ahead = true;
+    for(size_t i = 0; i < stateSpace.size(); i++) {
+      ahead = ahead && speculation->second.stateSpace[i] >= stateSpace[i];
+    }
+
+    if(ahead && getDelta(speculation->second.probabilities, probabilities) <= UPDATE_PROBABILITY_DELTA) {
+      speculation++;
+    } else {
+      STORMConnector::instance().cancelSpeculativeUpdate(this, speculation->first);
+      speculation = speculations.erase(speculation);
+    }
+  }
+
+  // the growth raises a lane by one step
+  size_t budget = getStateBudget();
+  size_t actionCount = controller.getActionSpace().size();
+  for(size_t i = 0; i < stateSpace.size(); i++) {
+    auto nextStateSpace = stateSpace;
+    nextStateSpace[i]++;
+    if(nextStateSpace[i] > (int)gConfig.maxLaneSize
+        || (budget > 0 && getModelSize(nextStateSpace, actionCount).states > budget)) {
+      continue;
+    }
+
+    bool known = false;
+    for(const auto &speculation : speculations) {
+      known = known || speculation.second.stateSpace==nextStateSpace;
+    }
+    if(known) {
+      continue;
+    }
+
+    Environment nextEnvironment = environment;
+    nextEnvironment.setStateSpace(nextStateSpace);
+    struct STORMModel model = getSTORMModel(nextEnvironment);
+    if(gConfig.backend!="auto") {
+      model.backend = gConfig.backend;
+    }
+
+    auto &speculation = speculations[model.key];
+    speculation.stateSpace = nextStateSpace;
+    speculation.probabilities = probabilities;
+    if(!gConfig.noStrategyCache && StrategyCache::instance().lookup(model.key, speculation.table)) {
+      speculation.solved = true;
+      continue;
+    }
+
+    STORMConnector::instance().startSpeculativeUpdate(this, model);
+  }
+}
+
+bool Shield::installSpeculation() {
+  auto stateSpace = environment.getStateSpace();
+  auto probabilities = quantizePMF(environment.getProbabilities());
+
+  for(const auto &speculation : speculations) {
+    if(speculation.second.solved && speculation.second.stateSpace==stateSpace
+        && getDelta(speculation.second.probabilities, probabilities) <= UPDATE_PROBABILITY_DELTA) {
+      // a queued job would load an outdated model
+      STORMConnector::instance().cancelStrategyUpdate(this);
+      getStrategy()->setStrategyTable(speculation.second.table);
+
+      STORMConnector::instance().cancelSpeculativeUpdates(this);
+      speculations.clear();
+
+      installStrategy();
+      return true;
+    }
+  }
+
+  return false;
+}
 
-  createPRISMFile(environment, controller);
-  createPropFile();
+void Shield::shareSpeculativeStrategyCallback(const std::string &modelKey, const StrategyTable &table) {
+  if(!gConfig.noStrategyCache) {
+    StrategyCache::instance().insert(modelKey, table);
+  }
 
-  STORMConnector::instance().startStrategyUpdate(this);
+  auto speculation = speculations.find(modelKey);
+  if(speculation!=speculations.end()) {
+    speculation->second.table = table;
+    speculation->second.solved = true;
+  }
+}
+
+void Shield::shareSpeculativeFailureCallback(const std::string &modelKey) {
+  auto speculation = speculations.find(modelKey);
+  if(speculation!=speculations.end() && !speculation->second.solved) {
+    speculations.erase(speculation);
+  }
 }
 
 Strategy *Shield::getStrategy() {
   return &strategy;
 }
 
-void Shield::updateStrategyCallback() {
-  getStrategy()->loadSchedFile();
+std::shared_ptr<MDPSolver> Shield::getSolver() const {
+  return solver;
+}
+
+void Shield::updateStrategyCallback(const StrategyTable &table, const std::string &modelKey) {
+  getStrategy()->setStrategyTable(table);
+  if(!gConfig.noStrategyCache) {
+    StrategyCache::instance().insert(modelKey, table);
+  }
+
+  installStrategy();
+}
+
+void Shield::shareStrategyCallback(const StrategyTable &table) {
+  getStrategy()->setStrategyTable(table);
+  installStrategy();
+}
+
+void Shield::installStrategy() {
   getStrategy()->exportStrategy();
 
   generation++;
+  strategyAge = 0;
 
   // update state space
   if(!newStateSpace.empty()) {
     lastStateSpace = environment.getStateSpace();
   }
+
+  // the growth probe succeeded
+  if(!failedStateSpace.empty()) {
+    auto stateSpace = strategy.getStateSpace();
+    bool covered = stateSpace.size()==failedStateSpace.size();
+    for(size_t i = 0; covered && i < stateSpace.size(); i++) {
+      covered = stateSpace[i] >= failedStateSpace[i];
+    }
+    if(covered) {
+      failedStateSpace.clear();
+      backoffLength = 0;
+      backoff = 0;
+    }
+  }
 }
 
-void Shield::lockStateSpaceSize() {
+void Shield::synthesisFailureCallback() {
   if(ALLOW_FAIL_ON_STATE_SPACE_SIZE) {
     assert("STORM died due to the PRISM complexity, check out ALLOW_FAIL_ON_STATESPACE_SIZE");
   }
 
-  // if STORM crash due to the complexity we lock the state space on the size before the crash
-  maxStateSpaceSizeReached = true;
-  environment.setStateSpace(lastStateSpace); // reset to working size
+  // every failure in a row doubles the updates until the growth gets probed again
+  failedStateSpace = environment.getStateSpace();
+  backoffLength = std::min(std::max(1, 2*backoffLength), SYNTHESIS_MAX_BACKOFF);
+  backoff = backoffLength;
+
+  if(generation >= 0) {
+    // reset to working size
+    environment.setStateSpace(strategy.getStateSpace());
+    return;
+  }
+
+  // no strategy yet, retry with a smaller state space
+  auto stateSpace = environment.getStateSpace();
+  bool shrunk = false;
+  for(auto &size : stateSpace) {
+    if(size > 1) {
+      size = std::max(1, size/2);
+      shrunk = true;
+    }
+  }
+
+  if(shrunk) {
+    environment.setStateSpace(stateSpace);
+    createStrategy(false);
+  }
 }
 
 std::vector<int> Shield::checkStateInfo() {
+  if(stateSpaceHistory.empty()) {
+    // no observation yet (e.g. a sub-shield updated before its first action), keep the state space
+    return environment.getStateSpace();
+  }
+
   std::vector<int> newStateInfo(stateSpaceHistory.at(0).size(), 0);
 
   for(const auto &h : stateSpaceHistory) {
@@ -137,9 +586,83 @@ std::vector<int> Shield::checkStateInfo() {
   return newStateInfo;
 }
 
+size_t Shield::getStateBudget() const {
+  size_t budget = gConfig.stateBudget;
+
+  // time budget from the measured throughput, no limit until the first synthesis finished
+  double throughput = STORMConnector::instance().getThroughput();
+  if(gConfig.timeBudget > 0. && throughput > 0.) {
+    auto timeBudget = (size_t)(gConfig.timeBudget*throughput);
+    budget = budget > 0 ? std::min(budget, timeBudget) : timeBudget;
+  }
+
+  return budget;
+}
+
+std::vector<int> Shield::fitStateBudget(const std::vector<int> &stateInfo, size_t budget) const {
+  auto stateSpace = environment.getStateSpace();
+  size_t actionCount = controller.getActionSpace().size();
+
+  std::vector<int> target(stateInfo.size());
+  std::vector<int> grown = stateSpace;
+  for(size_t i = 0; i < stateInfo.size(); i++) {
+    target[i] = std::max(1, std::min(stateInfo[i], (int)gConfig.maxLaneSize));
+    grown[i] = std::max(grown[i], target[i]);
+  }
+
+  if(getModelSize(grown, actionCount).states <= budget) {
+    return stateInfo;
+  }
+
+  // the budget binds, grow lane by lane and give the lanes with the highest queue pressure
+  // (arrival probability x missing capacity) the extra capacity first
+  auto probabilities = environment.getProbabilities();
+  while(true) {
+    int best = -1;
+    float bestPressure = 0.;
+    for(size_t i = 0; i < stateSpace.size(); i++) {
+      if(stateSpace[i] >= target[i]) {
+        continue;
+      }
+
+      stateSpace[i]++;
+      bool fits = getModelSize(stateSpace, actionCount).states <= budget;
+      stateSpace[i]--;
+
+      float pressure = probabilities[i]*(target[i] - stateSpace[i]);
+      if(fits && (best==-1 || pressure > bestPressure)) {
+        best = (int)i;
+        bestPressure = pressure;
+      }
+    }
+
+    if(best==-1) {
+      break;
+    }
+    stateSpace[best]++;
+  }
+
+  return stateSpace;
+}
+
 void Shield::updateStateSpace() {
   //std::lock_guard<std::mutex> lock{mutexStrategy};
-  environment.updateStateSpace(checkStateInfo());
+  auto stateInfo = checkStateInfo();
+  size_t budget = getStateBudget();
+  if(budget > 0) {
+    stateInfo = fitStateBudget(stateInfo, budget);
+  }
+  environment.updateStateSpace(stateInfo);
+
+  // keep the working state space until the back off expired
+  auto strategyStateSpace = strategy.getStateSpace();
+  if(backoff > 0 && !strategyStateSpace.empty()) {
+    auto stateSpace = environment.getStateSpace();
+    for(size_t i = 0; i < stateSpace.size() && i < strategyStateSpace.size(); i++) {
+      stateSpace[i] = std::min(stateSpace[i], strategyStateSpace[i]);
+    }
+    environment.setStateSpace(stateSpace);
+  }
 }
 
 void Shield::updateStateProbabilities() {
@@ -152,24 +675,63 @@ void Shield::updateActionProbabilities() {
 
 void Shield::updateHaltingNumbers(const std::vector<int> &haltingNumbers) {
   environment.updateHaltingNumbers(haltingNumbers);
+  for(size_t g = 0; g < subShields.size(); g++) {
+    subShields[g]->updateHaltingNumbers(project(haltingNumbers, laneGroups[g]));
+  }
 }
 
 void Shield::updateVehicleNumbers(const std::vector<int> &vehicleNumbers) {
   environment.updateVehicleNumbers(vehicleNumbers);
+  for(size_t g = 0; g < subShields.size(); g++) {
+    subShields[g]->updateVehicleNumbers(project(vehicleNumbers, laneGroups[g]));
+  }
 }
 
 void Shield::updateJunctionPhase(int currentJunctionPhase) {
   controller.updateJunctionPhase(currentJunctionPhase);
+  for(const auto &subShield : subShields) {
+    subShield->updateJunctionPhase(currentJunctionPhase);
+  }
 }
 
 void Shield::update() {
+  if(subShields.empty()) {
+    updateShield(!gConfig.asyncUpdate);
+    return;
+  }
+
+  // the environment of the junction only logs the observations
+  updateStateProbabilities();
+
+  for(const auto &subShield : subShields) {
+    subShield->updateShield(false);
+  }
+  if(!gConfig.asyncUpdate) {
+    for(const auto &subShield : subShields) {
+      STORMConnector::instance().waitForStrategyUpdate(subShield.get());
+    }
+  }
+
+  auto stateSpace = environment.getStateSpace();
+  for(size_t g = 0; g < subShields.size(); g++) {
+    auto groupStateSpace = subShields[g]->getEnvironment()->getStateSpace();
+    for(size_t i = 0; i < laneGroups[g].size(); i++) {
+      stateSpace[laneGroups[g][i]] = groupStateSpace[i];
+    }
+  }
+  environment.setStateSpace(stateSpace);
+}
+
+void Shield::updateShield(bool blocking) {
   clock_t start = clock();
+  strategyAge++;
 
   std::vector<float> environmentProbabilities = environment.getProbabilities();
   std::vector<int> stateSpace = environment.getStateSpace();
 
   // NOTE currently only static updates
-  bool doUpdate = gConfig.staticUpdate;
+  // a lazy shield synthesizes its first strategy from the probabilities of the warm up
+  bool doUpdate = gConfig.staticUpdate || (gConfig.lazyShields && generation < 0);
 
   //updateControllerProbabilities();
   updateStateProbabilities();
@@ -190,18 +752,19 @@ void Shield::update() {
 
   if(!lastEnvironmentProbabilities.empty()) {
     assert(lastEnvironmentProbabilities.size()==currentEnvironmentProbabilities.size());
-    float sumDelta = 0.;
-    for(size_t i = 0; i < currentEnvironmentProbabilities.size(); i++) {
-      sumDelta += std::abs(currentEnvironmentProbabilities[i] - lastEnvironmentProbabilities[i]);
-    }
+    // the model only sees the quantized probabilities (if enabled)
+    float sumDelta = getDelta(quantizePMF(currentEnvironmentProbabilities),
+                              quantizePMF(lastEnvironmentProbabilities));
 
     if(sumDelta > UPDATE_PROBABILITY_DELTA) {
       doUpdate = true;
     }
   }
 
-  // state space update can crash STORM
-  if(!maxStateSpaceSizeReached) {
+  // state space update can crash STORM, probe the growth after the back off
+  if(backoff > 0) {
+    backoff--;
+  } else {
     if(!lastStateSpace.empty() && !doUpdate) {
       assert(lastStateSpace.size()==currentStateSpace.size());
       for(size_t i = 0; i < currentStateSpace.size(); i++) {
@@ -216,18 +779,25 @@ void Shield::update() {
 
   if(doUpdate) {
     // std::cout << "DO Update for " << junction << std::endl;
-    lastEnvironmentProbabilities = currentEnvironmentProbabilities;
 
     //writeJson();
-    createStrategy();
+    if(createStrategy(blocking)) {
+      lastEnvironmentProbabilities = currentEnvironmentProbabilities;
+    }
   }
 
+  speculate();
+
   // std::cout << "Update success after " << float(clock() - start)/CLOCKS_PER_SEC << "s!" << std::endl;
 }
 
 
 
 int Shield::getNextAction(int currentAction) {
+  if(!subShields.empty()) {
+    return getComposedAction(currentAction);
+  }
+
   int shieldAction = -1;
 
   // Clip current state space on SUMO tls with state space from environment/shield,
@@ -241,17 +811,26 @@ int Shield::getNextAction(int currentAction) {
     }
   }
 
-  try {
-    if(!strategy.check()) {
-      return shieldAction;
-    }
+  if(!strategy.check()) {
+    return shieldAction;
+  }
 
-    stateSpaceHistory.push_back(currentStateSpace);
-    shieldAction = getStrategy()->getStrategyAction(currentStateSpace, currentAction);
-  } catch(std::exception &e) {
-    std::cerr << " -> " << environment.getStateSpaceSizeString() << "!" << std::endl;
+  stateSpaceHistory.push_back(currentStateSpace);
+  // no strategy yet (--lazy-shields or failed synthesis), only the statistics are tracked
+  if(generation < 0) {
+    return shieldAction;
+  }
+
+  // With background updates the environment can be ahead of the Strategy, clip on the smaller one.
+  if(gConfig.asyncUpdate) {
+    auto strategyStateSpace = strategy.getStateSpace();
+    for(size_t i = 0; i < currentStateSpace.size() && i < strategyStateSpace.size(); i++) {
+      currentStateSpace.at(i) = std::min(currentStateSpace.at(i), strategyStateSpace.at(i));
+    }
   }
 
+  // total lookup, states without mapping count as Strategy misses
+  shieldAction = getStrategy()->getStrategyAction(currentStateSpace, currentAction);
   return shieldAction;
 }
 
@@ -3,10 +3,15 @@
 #include "Controller.h"
 #include "Util.h"
 
+#include <cmath>
+#include <cassert>
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 #include <fstream>
+#include <sstream>
 #include <utility>
+#include <map>
 
 ShieldModelGenerator::ShieldModelGenerator(const std::string &filenamePrefix) :
     filenamePrefix(std::move(filenamePrefix)) {}
@@ -20,34 +25,273 @@ void ShieldModelGenerator::createPropFile() {
   PROPS.close();
 }
 
+std::string ShieldModelGenerator::getPropertiesString() const {
+  std::string props;
+  for(const auto &prop : properties) {
+    if(!props.empty()) {
+      props += ";";
+    }
+    props += prop;
+  }
+  return props;
+}
+
+struct ModelSize ShieldModelGenerator::getModelSize(const std::vector<int> &stateSpace, size_t actionCount) {
+  size_t laneStates = 1;
+  for(auto size : stateSpace) {
+    laneStates *= size + 1;
+  }
+
+  // arbiter (env, ctrl, shield move) x controller action x lanes
+  struct ModelSize size;
+  size.states = 3*actionCount*laneStates;
+  size.choices = actionCount*laneStates*(2 + actionCount);
+  size.transitions = actionCount*laneStates*(stateSpace.size() + actionCount + 2*actionCount);
+  return size;
+}
+
+struct ExplicitModel ShieldModelGenerator::getExplicitModel(const Environment &environment,
+                                                            const Controller &controller) {
+  struct ExplicitModel model;
+  model.labels = environment.getStateSpaceLabels();
+  model.stateSpace = environment.getStateSpace();
+  model.laneProbabilities = quantizePMF(environment.getProbabilities());
+  model.actionLabels = controller.getActionSpaceLabels();
+  model.actionProbabilities = quantizePMF(controller.getProbabilities());
+
+  for(const auto &way : controller.getActionSpaceWays()) {
+    std::vector<size_t> lanes;
+    for(const auto &w : way) {
+      auto lane = std::find(model.labels.begin(), model.labels.end(), w);
+      assert(lane!=model.labels.end() && "Controller way is not a environment label!");
+      lanes.push_back(lane - model.labels.begin());
+    }
+    model.ways.push_back(lanes);
+  }
+
+  return model;
+}
+
+void ShieldModelGenerator::writeDRNModel(std::ostream &out, const struct ExplicitModel &model) {
+  size_t laneCount = model.labels.size();
+  size_t actionCount = model.actionLabels.size();
+
+  std::vector<size_t> strides(laneCount);
+  size_t stateCount = 1;
+  for(size_t i = 0; i < laneCount; i++) {
+    strides[i] = stateCount;
+    stateCount *= model.stateSpace[i] + 1;
+  }
+
+  // same precision as the PRISM constants
+  auto round = [](double p) { return std::round(p*1e6)/1e6; };
+  std::vector<double> laneProbabilities;
+  for(auto p : model.laneProbabilities) {
+    laneProbabilities.push_back(round(p));
+  }
+  std::vector<double> actionProbabilities;
+  for(auto p : model.actionProbabilities) {
+    actionProbabilities.push_back(round(p));
+  }
+
+  auto index = [&](size_t lanes, size_t action, size_t move) {
+    return (lanes*actionCount + action)*3 + move;
+  };
+
+  out << std::fixed << std::setprecision(6);
+  out << "@type: MDP\n";
+  out << "@parameters\n\n";
+  out << "@reward_models\nrewards\n";
+  out << "@nr_states\n" << stateCount*actionCount*3 << "\n";
+  out << "@nr_choices\n" << stateCount*actionCount*(2 + actionCount) << "\n";
+  out << "@model\n";
+
+  std::vector<int> lanes(laneCount, 0);
+  std::vector<size_t> decrements(actionCount);
+  std::vector<int> wayMax(actionCount);
+  std::map<size_t, double> targets;
+
+  for(size_t x = 0; x < stateCount; x++) {
+    // shield move: the lanes of the way get one vehicle less
+    for(size_t k = 0; k < actionCount; k++) {
+      decrements[k] = x;
+      wayMax[k] = 0;
+      for(auto lane : model.ways[k]) {
+        if(lanes[lane] > 0) {
+          decrements[k] -= strides[lane];
+        }
+        wayMax[k] = std::max(wayMax[k], lanes[lane]);
+      }
+    }
+
+    // reward: max. difference of the way queues
+    double reward = 0.;
+    bool first = true;
+    for(size_t k1 = 0; k1 < actionCount; k1++) {
+      for(size_t k2 = 0; k2 < actionCount; k2++) {
+        if(model.ways[k1]!=model.ways[k2]) {
+          double difference = wayMax[k1] - wayMax[k2];
+          reward = first ? difference : std::max(reward, difference);
+          first = false;
+        }
+      }
+    }
+
+    std::string valuation;
+    for(size_t i = 0; i < laneCount; i++) {
+      valuation += ", " + model.labels[i] + "=" + std::to_string(lanes[i]);
+    }
+
+    for(size_t j = 0; j < actionCount; j++) {
+      std::string stateValuation = ", action=" + std::to_string(j) + valuation + ">";
+
+      // environment move: one lane gets a vehicle more
+      out << "state " << index(x, j, 0) << " [0] <move=0" << stateValuation << (x==0 && j==0 ? " init" : "") << "\n";
+      out << "\taction env [0]\n";
+      targets.clear();
+      for(size_t i = 0; i < laneCount; i++) {
+        if(laneProbabilities[i] > 0.) {
+          size_t target = lanes[i] < model.stateSpace[i] ? x + strides[i] : x;
+          targets[index(target, j, 1)] += laneProbabilities[i];
+        }
+      }
+      for(const auto &target : targets) {
+        out << "\t\t" << target.first << " : " << target.second << "\n";
+      }
+
+      // controller move
+      out << "state " << index(x, j, 1) << " [0] <move=1" << stateValuation << "\n";
+      out << "\taction ctrl [0]\n";
+      for(size_t k = 0; k < actionCount; k++) {
+        if(actionProbabilities[k] > 0.) {
+          out << "\t\t" << index(x, k, 2) << " : " << actionProbabilities[k] << "\n";
+        }
+      }
+
+      // shield move
+      out << "state " << index(x, j, 2) << " [0] <move=2" << stateValuation << "\n";
+      for(size_t k = 0; k < actionCount; k++) {
+        out << "\taction " << model.actionLabels[k] << " [" << reward + (k!=j ? gConfig.d : 0.) << "]\n";
+        if(decrements[k]==x) {
+          out << "\t\t" << index(x, j, 0) << " : " << 1. << "\n";
+        } else {
+          out << "\t\t" << index(decrements[k], j, 0) << " : " << 0.9 << "\n";
+          out << "\t\t" << index(x, j, 0) << " : " << 0.1 << "\n";
+        }
+      }
+    }
+
+    // next lane state
+    for(size_t i = 0; i < laneCount; i++) {
+      if(++lanes[i] <= model.stateSpace[i]) {
+        break;
+      }
+      lanes[i] = 0;
+    }
+  }
+}
+
+void ShieldModelGenerator::createDRNFile(const struct ExplicitModel &model) {
+  std::ofstream DRN(out_path_ + filenamePrefix + ".drn", std::ios::trunc);
+  DRN << "// " << filenamePrefix + ".drn" << " Created at " << getTimeString() << "\n";
+  writeDRNModel(DRN, model);
+  DRN.close();
+}
+
 void ShieldModelGenerator::createPRISMFile(const Environment &environment, const Controller &controller) {
+  createPRISMFile(getPRISMModel(environment, controller));
+}
+
+void ShieldModelGenerator::createPRISMFile(const std::string &model) {
   std::ofstream PRISM(out_path_ + filenamePrefix + ".prism", std::ios::trunc);
+  PRISM << "// " << filenamePrefix + ".prism" << " Created at " << getTimeString() << "\n\n";
+  PRISM << model;
+  PRISM.close();
+}
 
+std::string ShieldModelGenerator::getPRISMModel(const Environment &environment, const Controller &controller) const {
+  std::stringstream PRISM;
+  writePRISMModel(PRISM, environment, controller, false);
+  return PRISM.str();
+}
+
+const std::string &ShieldModelGenerator::getPRISMTemplate(const Environment &environment,
+                                                          const Controller &controller) {
+  if(prismTemplate.empty() || prismTemplateLabels!=environment.getStateSpaceLabels()) {
+    std::stringstream PRISM;
+    writePRISMModel(PRISM, environment, controller, true);
+    prismTemplate = PRISM.str();
+    prismTemplateLabels = environment.getStateSpaceLabels();
+  }
+  return prismTemplate;
+}
+
+std::string ShieldModelGenerator::getPRISMConstants(const Environment &environment, const Controller &controller) {
+  std::stringstream constants;
+
+  auto stateSpaceLabels = environment.getStateSpaceLabels();
+  auto stateSpace = environment.getStateSpace();
+  auto stateProbabilities = quantizePMF(environment.getProbabilities());
+
+  auto actionStateLabels = controller.getActionSpaceLabels();
+  auto actionProbabilities = quantizePMF(controller.getProbabilities());
+
+  // same precision as the defined constants
+  constants << std::fixed << std::setprecision(6);
+  for(size_t i = 0; i < stateSpaceLabels.size(); i++) {
+    constants << stateSpaceLabels.at(i) << "Prob=" << stateProbabilities.at(i) << ",";
+  }
+  for(size_t i = 0; i < stateSpaceLabels.size(); i++) {
+    constants << stateSpaceLabels.at(i) << "Max=" << stateSpace.at(i) << ",";
+  }
+  for(size_t i = 0; i < actionProbabilities.size(); i++) {
+    constants << actionStateLabels.at(i) << "Prob=" << actionProbabilities.at(i) << ",";
+  }
+
+  std::string values = constants.str();
+  if(!values.empty()) {
+    values.pop_back();
+  }
+  return values;
+}
+
+void ShieldModelGenerator::writePRISMModel(std::ostream &PRISM, const Environment &environment,
+                                           const Controller &controller, bool parametric) const {
   auto stateSpaceLabels = environment.getStateSpaceLabels();
   auto stateSpace = environment.getStateSpace();
-  auto stateWeights = environment.getWeights();
-  auto stateProbabilities = environment.getProbabilities();
+  auto stateProbabilities = quantizePMF(environment.getProbabilities());
 
   auto actionStateLabels = controller.getActionSpaceLabels();
   auto actionSpace = controller.getActionSpace();
-  auto actionProbabilities = controller.getProbabilities();
+  auto actionProbabilities = quantizePMF(controller.getProbabilities());
 
-  PRISM << "// " << filenamePrefix + ".prism" << " Created at " << getTimeString() << "\n\n";
   PRISM << modelType_ << "\n\n";
 
   for(size_t i = 0; i < stateSpaceLabels.size(); i++) {
-    PRISM << "const double " << stateSpaceLabels.at(i) << "Prob = " <<
-          std::fixed << std::setprecision(6) << stateProbabilities.at(i) << ";\n";
+    if(parametric) {
+      PRISM << "const double " << stateSpaceLabels.at(i) << "Prob;\n";
+    } else {
+      PRISM << "const double " << stateSpaceLabels.at(i) << "Prob = " <<
+            std::fixed << std::setprecision(6) << stateProbabilities.at(i) << ";\n";
+    }
   }
   PRISM << "\n";
 
   for(size_t i = 0; i < stateSpaceLabels.size(); i++) {
-    PRISM << "const int " << stateSpaceLabels.at(i) << "Max = " << stateSpace.at(i) << ";\n";
+    if(parametric) {
+      PRISM << "const int " << stateSpaceLabels.at(i) << "Max;\n";
+    } else {
+      PRISM << "const int " << stateSpaceLabels.at(i) << "Max = " << stateSpace.at(i) << ";\n";
+    }
   }
   PRISM << "\n";
 
   for(size_t i = 0; i < actionProbabilities.size(); i++) {
-    PRISM << "const double " << actionStateLabels.at(i) << "Prob = " << actionProbabilities.at(i) << ";\n";
+    if(parametric) {
+      PRISM << "const double " << actionStateLabels.at(i) << "Prob;\n";
+    } else {
+      PRISM << "const double " << actionStateLabels.at(i) << "Prob = " << actionProbabilities.at(i) << ";\n";
+    }
   }
   PRISM << "\n";
 
@@ -65,7 +309,13 @@ void ShieldModelGenerator::createPRISMFile(const Environment &environment, const
 
   PRISM << "module shield\n";
   for(size_t i = 0; i < stateSpaceLabels.size(); i++) {
-    PRISM << "\t" << stateSpaceLabels.at(i) << ": [0 .. " << stateSpace.at(i) << "] init 0;\n";
+    PRISM << "\t" << stateSpaceLabels.at(i) << ": [0 .. ";
+    if(parametric) {
+      PRISM << stateSpaceLabels.at(i) << "Max";
+    } else {
+      PRISM << stateSpace.at(i);
+    }
+    PRISM << "] init 0;\n";
   }
   PRISM << "\n";
 
@@ -85,7 +335,66 @@ void ShieldModelGenerator::createPRISMFile(const Environment &environment, const
   PRISM << "endrewards\n\n";
 }
 
+std::string ShieldModelGenerator::getModelKey(const std::string &model, const std::vector<std::string> &labels) const {
+  std::map<std::string, std::string> positions;
+  for(size_t i = 0; i < labels.size(); i++) {
+    positions[labels[i]] = "lane" + std::to_string(i);
+    positions[labels[i] + "Prob"] = "lane" + std::to_string(i) + "Prob";
+    positions[labels[i] + "Max"] = "lane" + std::to_string(i) + "Max";
+  }
+
+  // replace whole identifiers only, a label can be the prefix of another label
+  std::string canonical;
+  size_t i = 0;
+  while(i < model.size()) {
+    if(std::isalpha(model[i]) || model[i]=='_') {
+      size_t end = i;
+      while(end < model.size() && (std::isalnum(model[end]) || model[end]=='_')) {
+        end++;
+      }
+
+      std::string identifier = model.substr(i, end - i);
+      auto position = positions.find(identifier);
+      canonical += position!=positions.end() ? position->second : identifier;
+      i = end;
+    } else if(std::isdigit(model[i])) {
+      // keep numbers, also if they contain letters (e.g. exponents)
+      while(i < model.size() && (std::isalnum(model[i]) || model[i]=='.')) {
+        canonical += model[i++];
+      }
+    } else {
+      canonical += model[i++];
+    }
+  }
+
+  for(const auto &prop : properties) {
+    canonical += prop + "\n";
+  }
+  return hashString(canonical);
+}
+
+void ShieldModelGenerator::createDefaultModel(const Environment &environment, const Controller &controller) {
+  setModelType("mdp");
+  setProperties({"Rmin=? [ LRA ]"});
+
+  createPRISMArbiter(controller);
+  createPRISMController(controller);
+  createPRISMShield(controller);
+  createPRISMRewards(controller);
+  createPRISMEnvironment(environment);
+}
+
+bool ShieldModelGenerator::hasDefaultModel(const Environment &environment, const Controller &controller) const {
+  ShieldModelGenerator generated;
+  generated.createDefaultModel(environment, controller);
+  return modelType_==generated.modelType_ && properties==generated.properties &&
+      module_arbiter==generated.module_arbiter && module_environment==generated.module_environment &&
+      module_controller==generated.module_controller && module_shield==generated.module_shield &&
+      module_rewards==generated.module_rewards;
+}
+
 void ShieldModelGenerator::createPRISMArbiter(const Controller &controller) {
+  prismTemplate.clear();
   std::vector<std::string> out;
   out.push_back("[env]    (move = 0) -> 1:(move' = 1);");
   out.push_back("[ctrl]   (move = 1) -> 1:(move' = 2);");
@@ -96,6 +405,7 @@ void ShieldModelGenerator::createPRISMArbiter(const Controller &controller) {
 }
 
 void ShieldModelGenerator::createPRISMEnvironment(const Environment &environment) {
+  prismTemplate.clear();
   std::vector<std::string> out;
   out.push_back("[env] (true) ->");
   for(const auto &l : environment.getStateSpaceLabels()) {
@@ -107,6 +417,7 @@ void ShieldModelGenerator::createPRISMEnvironment(const Environment &environment
 }
 
 void ShieldModelGenerator::createPRISMController(const Controller &controller) {
+  prismTemplate.clear();
   std::vector<std::string> out;
   auto actionSpaceLabels = controller.getActionSpaceLabels();
   std::string line = "[ctrl] (true) -> ";
@@ -119,6 +430,7 @@ void ShieldModelGenerator::createPRISMController(const Controller &controller) {
 }
 
 void ShieldModelGenerator::createPRISMShield(const Controller &controller) {
+  prismTemplate.clear();
   std::vector<std::string> out;
   auto actionSpaceLabels = controller.getActionSpaceLabels();
   auto actionSpaceWay = controller.getActionSpaceWays();
@@ -126,6 +438,11 @@ void ShieldModelGenerator::createPRISMShield(const Controller &controller) {
     for(size_t j = 0; j < actionSpaceLabels.size(); j++) {
       std::string line = "[" + actionSpaceLabels[i] + "]";
       line += " action=" + std::to_string(j) + " -> ";
+      if(actionSpaceWay[i].empty()) {
+        // the phase serves no lane of the model (sub-shields)
+        out.push_back(line + "1 : true;");
+        continue;
+      }
       line += "0.9 : ";
       for(const auto &w : actionSpaceWay[i]) {
         line += "(" + w + "'=max(0, " + w + " - 1)) &";
@@ -139,6 +456,7 @@ void ShieldModelGenerator::createPRISMShield(const Controller &controller) {
 }
 
 void ShieldModelGenerator::createPRISMRewards(const Controller &controller) {
+  prismTemplate.clear();
   std::vector<std::string> out;
   auto actionSpaceLabels = controller.getActionSpaceLabels();
   for(size_t i = 0; i < actionSpaceLabels.size(); i++) {
@@ -155,7 +473,9 @@ void ShieldModelGenerator::createPRISMRewards(const Controller &controller) {
   std::vector<std::string> maxWays;
   for(size_t i = 0; i < actionSpaceLabels.size(); i++) {
     std::string line;
-    if(ways[i].size()==1) {
+    if(ways[i].empty()) {
+      line = "0";
+    } else if(ways[i].size()==1) {
       line = ways[i][0];
     } else {
       line = "max(";
@@ -170,17 +490,22 @@ void ShieldModelGenerator::createPRISMRewards(const Controller &controller) {
   for(size_t i = 0; i < actionSpaceLabels.size(); i++) {
     for(size_t j = 0; j < actionSpaceLabels.size(); j++) {
       std::string line = "[" + actionSpaceLabels[i] + "]";
-      line += " action=" + std::to_string(j) + " : 1 * max(";
+      std::string differences;
       for(const auto &m1 : maxWays) {
         for(const auto &m2 : maxWays) {
           if(m1!=m2) {
-            line += "(" + m1 + "-" + m2 + "),";
+            differences += "(" + m1 + "-" + m2 + "),";
           }
         }
       }
 
-      line.back() = ')';
-      line += ";";
+      if(differences.empty()) {
+        // all phases serve the same lanes
+        line += " action=" + std::to_string(j) + " : 0;";
+      } else {
+        differences.back() = ')';
+        line += " action=" + std::to_string(j) + " : 1 * max(" + differences + ";";
+      }
       out.push_back(line);
     }
   }
@@ -189,29 +514,36 @@ void ShieldModelGenerator::createPRISMRewards(const Controller &controller) {
 }
 
 void ShieldModelGenerator::setModelType(std::string modelType) {
+  prismTemplate.clear();
   modelType_ = modelType;
 }
 
 void ShieldModelGenerator::setProperties(std::vector<std::string> module) {
+  prismTemplate.clear();
   properties = module;
 }
 
 void ShieldModelGenerator::setPRISMArbiter(const std::vector<std::string> &module) {
+  prismTemplate.clear();
   module_arbiter = module;
 }
 
 void ShieldModelGenerator::setPRISMEnvironment(const std::vector<std::string> &module) {
+  prismTemplate.clear();
   module_environment = module;
 }
 
 void ShieldModelGenerator::setPRISMController(const std::vector<std::string> &module) {
+  prismTemplate.clear();
   module_controller = module;
 }
 
 void ShieldModelGenerator::setPRISMShield(const std::vector<std::string> &module) {
+  prismTemplate.clear();
   module_shield = module;
 }
 
 void ShieldModelGenerator::setPRISMRewards(const std::vector<std::string> &module) {
+  prismTemplate.clear();
   module_rewards = module;
 }
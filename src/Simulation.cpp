@@ -1,5 +1,9 @@
+#include <chrono>
+
 #include "Simulation.h"
 #include "TrafficLight.h"
+#include "Shield.h"
+#include "STORMConnector.h"
 
 Simulation::Simulation(const std::string &sumoConfigFile,
                        const std::string &simulationLogFile,
@@ -29,7 +33,8 @@ Simulation::Simulation(const std::string &sumoConfigFile,
 
   sumo.connect();
 
-  clock_t simulationInitTime = clock();
+  // wall clock, the syntheses run in parallel
+  auto simulationInitTime = std::chrono::steady_clock::now();
 
   if(shield) {
     auto tlsIDs = sumo.getTrafficLightIDs();
@@ -74,7 +79,73 @@ Simulation::Simulation(const std::string &sumoConfigFile,
       }
     }
 
-    std::cout << "Simulation Init Time: " << float(clock() - simulationInitTime)/CLOCKS_PER_SEC << std::endl;
+    auto synthesisTime = std::chrono::steady_clock::now();
+    synthesizeStrategies();
+    auto endTime = std::chrono::steady_clock::now();
+
+    // only the traffic lights with a strategy get an offset
+    if(gConfig.staggerUpdates) {
+      staggerUpdates();
+    }
+
+    std::cout << "Simulation Init Time (build): "
+              << std::chrono::duration<float>(synthesisTime - simulationInitTime).count() << std::endl;
+    std::cout << "Simulation Init Time (synthesis): "
+              << std::chrono::duration<float>(endTime - synthesisTime).count() << std::endl;
+    std::cout << "Simulation Init Time: " << std::chrono::duration<float>(endTime - simulationInitTime).count()
+              << std::endl;
+  }
+}
+
+void Simulation::synthesizeStrategies() {
+  size_t loaded = 0;
+  for(auto object = trafficLight.begin(); object!=trafficLight.end();) {
+    auto *t = static_cast<TrafficLight *>(*object);
+    if(t->getShield()==nullptr) {
+      ++object;
+      continue;
+    }
+
+    try {
+      // lazy shields only take solved models, the first synthesis follows the warm up
+      if(gConfig.lazyShields) {
+        loaded += t->getShield()->loadCachedStrategy() ? 1 : 0;
+      } else {
+        t->getShield()->createStrategy(false);
+      }
+      ++object;
+    }
+    catch(std::exception &e) {
+      // as a failing build, the traffic light is not simulated
+      std::cout << "Traffic Light " << t->getTrafficLightID()
+                << " can not synthesize a strategy, it will be disabled! (" << e.what() << ")" << std::endl;
+      delete *object;
+      object = trafficLight.erase(object);
+    }
+  }
+
+  if(gConfig.lazyShields) {
+    std::cout << "Lazy shields: " << loaded << " strategies loaded from the cache" << std::endl;
+    return;
+  }
+
+  // the pool runs up to --synthesis-jobs STORM processes or native solver threads in parallel,
+  // the first step needs all strategies
+  STORMConnector::instance().waitForAllStrategyUpdates();
+}
+
+void Simulation::staggerUpdates() {
+  std::vector<TrafficLight *> shielded;
+  for(auto object : trafficLight) {
+    auto *t = static_cast<TrafficLight *>(object);
+    if(t->getShield()!=nullptr) {
+      shielded.push_back(t);
+    }
+  }
+
+  // the i-th junction of n gets the offset i*interval/n, the order of SUMO keeps it deterministic
+  for(size_t i = 0; i < shielded.size(); i++) {
+    shielded[i]->setUpdateOffset(i*gConfig.updateInterval/shielded.size());
   }
 }
 
@@ -99,6 +170,9 @@ void Simulation::step() {
   sumo.step();
   tim.step();
 
+  // load finished strategies before the traffic lights take decisions
+  STORMConnector::instance().poll();
+
   for(auto &tl : trafficLight) {
     tl->step();
   }
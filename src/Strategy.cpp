@@ -1,12 +1,287 @@
 #include <cmath>
 #include <cassert>
+#include <cerrno>
+#include <cstdlib>
 #include <iostream>
 #include <algorithm>
 #include <fstream>
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "Strategy.h"
 #include "Util.h"
 
+size_t StrategyTable::StateHash::operator()(const std::vector<int> &key) const {
+  size_t hash = key.size();
+  for(int value : key) {
+    hash ^= std::hash<int>()(value) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+  }
+  return hash;
+}
+
+StrategyTable::StrategyTable(const std::vector<int> &stateSpace, int actionCount) {
+  layout(stateSpace, actionCount);
+}
+
+StrategyTable::StrategyTable(const std::vector<struct StrategyStep> &steps) {
+  if(steps.empty()) {
+    return;
+  }
+
+  std::vector<int> maxState = steps.front().state;
+  int maxAction = 0;
+  for(const auto &step : steps) {
+    if(step.state.size()!=maxState.size()) {
+      maxState.clear();
+      break;
+    }
+    for(size_t i = 0; i < step.state.size(); i++) {
+      maxState[i] = std::max(maxState[i], step.state[i]);
+    }
+    maxAction = std::max(maxAction, step.currentAction);
+  }
+  if(!maxState.empty()) {
+    layout(maxState, maxAction + 1);
+  }
+
+  for(const auto &step : steps) {
+    set(step.state, step.currentAction, step.nextAction);
+  }
+}
+
+void StrategyTable::set(const std::vector<int> &state, int currentAction, int nextAction) {
+  if(!isSparse && (nextAction < 0 || nextAction >= UINT16_MAX)) {
+    layout({}, 0);
+  } else if(!isSparse && !contains(state, currentAction)) {
+    bool negative = currentAction < 0 || std::any_of(state.begin(), state.end(), [](int i) { return i < 0; });
+    if(negative || (!bounds.empty() && bounds.size()!=state.size())) {
+      layout({}, 0);
+    } else {
+      // grow the exceeded dimensions geometrically, mappings added one by one move the table
+      // a logarithmic number of times, the exact fit is kept if the grown layout is too large
+      std::vector<int> newBounds = bounds.empty() ? state : bounds;
+      std::vector<int> grownBounds = newBounds;
+      for(size_t i = 0; i < state.size(); i++) {
+        if(state[i] > newBounds[i]) {
+          newBounds[i] = state[i];
+          grownBounds[i] = std::max(state[i], 2*grownBounds[i] + 1);
+        }
+      }
+      int newActionCount = std::max(actionCount, currentAction + 1);
+      int grownActionCount = currentAction < actionCount ? actionCount : std::max(currentAction + 1, 2*actionCount);
+
+      if(bounds.empty() || layoutSize(grownBounds, grownActionCount) > STRATEGY_TABLE_DENSE_MAX) {
+        layout(newBounds, newActionCount);
+      } else {
+        layout(grownBounds, grownActionCount);
+      }
+    }
+  }
+
+  if(isSparse) {
+    std::vector<int> key = state;
+    key.push_back(currentAction);
+    auto mapping = sparse.emplace(std::move(key), nextAction);
+    if(mapping.second) {
+      count++;
+    } else {
+      mapping.first->second = nextAction;
+    }
+  } else {
+    uint16_t &entry = dense[index(state, currentAction)];
+    count += entry==0 ? 1 : 0;
+    entry = (uint16_t)(nextAction + 1);
+  }
+
+  if(stateSpace.size()!=state.size()) {
+    stateSpace = state;
+  }
+  for(size_t i = 0; i < state.size(); i++) {
+    stateSpace[i] = std::max(stateSpace[i], state[i]);
+  }
+}
+
+int StrategyTable::get(const std::vector<int> &state, int currentAction) const noexcept {
+  if(isSparse) {
+    // reuse the key buffer, no allocation per lookup
+    static thread_local std::vector<int> key;
+    key.assign(state.begin(), state.end());
+    key.push_back(currentAction);
+    auto mapping = sparse.find(key);
+    return mapping==sparse.end() ? -1 : mapping->second;
+  }
+
+  if(!contains(state, currentAction)) {
+    return -1;
+  }
+  return (int)dense[index(state, currentAction)] - 1;
+}
+
+size_t StrategyTable::size() const {
+  return count;
+}
+
+bool StrategyTable::empty() const {
+  return count==0;
+}
+
+void StrategyTable::clear() {
+  *this = StrategyTable();
+}
+
+const std::vector<int> &StrategyTable::getStateSpace() const {
+  return stateSpace;
+}
+
+int StrategyTable::getActionCount() const {
+  return isSparse ? 0 : actionCount;
+}
+
+const std::vector<int> &StrategyTable::getBounds() const {
+  return bounds;
+}
+
+const std::vector<uint16_t> &StrategyTable::getEntries() const {
+  return dense;
+}
+
+bool StrategyTable::assignDense(const std::vector<int> &newBounds, int newActionCount, std::vector<uint16_t> &&entries,
+                                size_t mappings, const std::vector<int> &maxState) {
+  if(newBounds.empty() || newActionCount <= 0 || maxState.size()!=newBounds.size()) {
+    return false;
+  }
+
+  size_t layoutSize = (size_t)newActionCount;
+  for(int bound : newBounds) {
+    if(bound < 0 || layoutSize > STRATEGY_TABLE_DENSE_MAX) {
+      return false;
+    }
+    layoutSize *= (size_t)bound + 1;
+  }
+  if(layoutSize > STRATEGY_TABLE_DENSE_MAX || layoutSize!=entries.size()) {
+    return false;
+  }
+
+  clear();
+  bounds = newBounds;
+  actionCount = newActionCount;
+  strides.assign(bounds.size(), 1);
+  size_t stride = (size_t)actionCount;
+  for(size_t lane = bounds.size(); lane-- > 0;) {
+    strides[lane] = stride;
+    stride *= (size_t)bounds[lane] + 1;
+  }
+  dense = std::move(entries);
+  count = mappings;
+  stateSpace = maxState;
+  return true;
+}
+
+std::vector<struct StrategyStep> StrategyTable::getSteps() const {
+  std::vector<struct StrategyStep> steps;
+  steps.reserve(count);
+
+  if(isSparse) {
+    for(const auto &mapping : sparse) {
+      std::vector<int> state(mapping.first.begin(), mapping.first.end() - 1);
+      steps.push_back({std::move(state), mapping.first.back(), mapping.second});
+    }
+    std::sort(steps.begin(), steps.end(), [](const struct StrategyStep &a, const struct StrategyStep &b) {
+      return a.state!=b.state ? a.state < b.state : a.currentAction < b.currentAction;
+    });
+    return steps;
+  }
+
+  // index order is the lexicographic order of (state, action)
+  std::vector<int> state(bounds.size(), 0);
+  int currentAction = 0;
+  for(size_t i = 0; i < dense.size(); i++) {
+    if(dense[i]!=0) {
+      steps.push_back({state, currentAction, (int)dense[i] - 1});
+    }
+
+    if(++currentAction < actionCount) {
+      continue;
+    }
+    currentAction = 0;
+    for(size_t lane = bounds.size(); lane-- > 0;) {
+      if(++state[lane] <= bounds[lane]) {
+        break;
+      }
+      state[lane] = 0;
+    }
+  }
+  return steps;
+}
+
+void StrategyTable::layout(const std::vector<int> &newBounds, int newActionCount) {
+  std::vector<struct StrategyStep> steps = getSteps();
+
+  size_t entries = layoutSize(newBounds, newActionCount);
+
+  bounds.clear();
+  strides.clear();
+  dense.clear();
+  sparse.clear();
+  count = 0;
+  actionCount = 0;
+  isSparse = entries==0 || entries > STRATEGY_TABLE_DENSE_MAX;
+
+  if(!isSparse) {
+    bounds = newBounds;
+    actionCount = newActionCount;
+    strides.assign(bounds.size(), 1);
+    size_t stride = (size_t)actionCount;
+    for(size_t lane = bounds.size(); lane-- > 0;) {
+      strides[lane] = stride;
+      stride *= (size_t)bounds[lane] + 1;
+    }
+    dense.assign(entries, 0);
+  }
+
+  for(const auto &step : steps) {
+    set(step.state, step.currentAction, step.nextAction);
+  }
+}
+
+size_t StrategyTable::layoutSize(const std::vector<int> &newBounds, int newActionCount) {
+  // the size check stops before the product overflows
+  size_t entries = newBounds.empty() ? 0 : (size_t)newActionCount;
+  for(int bound : newBounds) {
+    if(entries > STRATEGY_TABLE_DENSE_MAX) {
+      break;
+    }
+    entries *= (size_t)bound + 1;
+  }
+  return entries;
+}
+
+bool StrategyTable::contains(const std::vector<int> &state, int currentAction) const noexcept {
+  if(bounds.empty() || state.size()!=bounds.size() || currentAction < 0 || currentAction >= actionCount) {
+    return false;
+  }
+  for(size_t i = 0; i < state.size(); i++) {
+    if(state[i] < 0 || state[i] > bounds[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t StrategyTable::index(const std::vector<int> &state, int currentAction) const noexcept {
+  size_t index = (size_t)currentAction;
+  for(size_t i = 0; i < state.size(); i++) {
+    index += (size_t)state[i]*strides[i];
+  }
+  return index;
+}
+
+size_t Strategy::totalMisses = 0;
+size_t Strategy::totalUnresolved = 0;
+
 Strategy::Strategy(const std::string &filePrefix, const std::vector<std::string> &labels)
     : labels(labels), filePrefix(filePrefix) {
   assert(check());
@@ -22,61 +297,356 @@ bool Strategy::check() const {
 }
 
 void Strategy::addStrategyStep(const std::vector<int> &state, int currentAction, int nextAction) {
-  strategy_[std::make_pair(state, currentAction)] = nextAction;
+  strategy_.set(state, currentAction, nextAction);
+  resetFallbacks();
 }
 
-int Strategy::getStrategyAction(std::pair<std::vector<int>, int> simulationState) {
+int Strategy::getStrategyAction(const std::pair<std::vector<int>, int> &simulationState) noexcept {
+  return getStrategyAction(simulationState.first, simulationState.second);
+}
+
+int Strategy::getStrategyAction(const std::vector<int> &state, int currentAction) noexcept {
 
   // not interesting
-  if(std::all_of(simulationState.first.begin(), simulationState.first.end(), [](int i) { return i==0; })) {
+  if(std::all_of(state.begin(), state.end(), [](int i) { return i==0; })) {
     return -1;
   }
 
-  //for(int i : state.first)
-  //  std::cout << std::to_string(i) + ",";
-  //std::cout << ";" << std::to_string(state.second) << std::endl;
+  int nextAction = strategy_.get(state, currentAction);
+  if(nextAction >= 0) {
+    return nextAction;
+  }
 
-  try {
-    return strategy_.at(simulationState);
-  } catch(std::exception &e) {
-    std::cerr << e.what() << " No shield action available!" << std::endl;
-
-    // FIND BEST MATCH
-    for(size_t i = 0; i < simulationState.first.size(); i++) {
-      std::pair<std::vector<int>, int> testState = simulationState;
-      if(testState.first[i]!=0) {
-        testState.first[i]--;
-        try {
-          return strategy_.at(testState);
-        } catch(std::exception &e) {
-          continue;
-        }
-      }
+  misses++;
+  totalMisses++;
+  nextAction = resolveFallback(state, currentAction);
+  if(nextAction < 0) {
+    unresolved++;
+    totalUnresolved++;
+  }
+  return nextAction;
+}
+
+size_t Strategy::getMisses() const {
+  return misses;
+}
+
+size_t Strategy::getUnresolved() const {
+  return unresolved;
+}
+
+size_t Strategy::getTotalMisses() {
+  return totalMisses;
+}
+
+size_t Strategy::getTotalUnresolved() {
+  return totalUnresolved;
+}
+
+void Strategy::resetFallbacks() {
+  fallbacks_.clear();
+  resolved = false;
+}
+
+int Strategy::resolveFallback(const std::vector<int> &state, int currentAction) noexcept {
+  int actionCount = strategy_.getActionCount();
+  if(actionCount==0 || currentAction < 0 || currentAction >= actionCount || !covers(state)) {
+    return findFallback(state, currentAction);
+  }
+
+  if(!resolved) {
+    // first miss of the table, the covered state space is inside the dense layout
+    try {
+      fallbacks_ = StrategyTable(strategy_.getStateSpace(), actionCount);
+    } catch(std::bad_alloc &e) {
+      return findFallback(state, currentAction);
     }
+    resolved = true;
+  }
 
-    throw;
+  int nextAction = fallbacks_.get(state, currentAction);
+  if(nextAction < 0) {
+    // states without fallback are searched again, the table has no entry for them
+    nextAction = findFallback(state, currentAction);
+    if(nextAction >= 0) {
+      fallbacks_.set(state, currentAction, nextAction);
+    }
   }
+  return nextAction;
 }
 
-int Strategy::getStrategyAction(const std::vector<int> &state, int currentAction) {
-  return getStrategyAction(std::make_pair(state, currentAction));
+bool Strategy::covers(const std::vector<int> &state) const noexcept {
+  const auto &stateSpace = strategy_.getStateSpace();
+  if(state.size()!=stateSpace.size()) {
+    return false;
+  }
+  for(size_t i = 0; i < state.size(); i++) {
+    if(state[i] < 0 || state[i] > stateSpace[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int Strategy::findFallback(const std::vector<int> &state, int currentAction) const noexcept {
+  // FIND BEST MATCH
+  static thread_local std::vector<int> testState;
+  testState.assign(state.begin(), state.end());
+  for(size_t i = 0; i < testState.size(); i++) {
+    if(testState[i]!=0) {
+      testState[i]--;
+      int nextAction = strategy_.get(testState, currentAction);
+      testState[i]++;
+      if(nextAction >= 0) {
+        return nextAction;
+      }
+    }
+  }
+  return -1;
+}
+
+const StrategyTable &Strategy::getStrategyTable() const {
+  return strategy_;
+}
+
+void Strategy::setStrategyTable(const StrategyTable &table) {
+  strategy_ = table;
+  resetFallbacks();
+}
+
+std::vector<int> Strategy::getStateSpace() const {
+  return strategy_.getStateSpace();
 }
 
 void Strategy::exportStrategy() {
+  if(!gConfig.debugFiles) {
+    return;
+  }
+
   std::ofstream stratFile(out_path_ + filePrefix + ".strat");
   stratFile << "// " << filePrefix + ".strat" << " Created at " << getTimeString() << std::endl;
+  writeStrategyTable(stratFile, strategy_);
+  stratFile.close();
 
-  for(std::pair<std::pair<std::vector<int>, int>, int> mapping : strategy_) {
+  std::ofstream binaryFile(out_path_ + filePrefix + ".bstrat", std::ios::binary);
+  writeBinaryStrategyTable(binaryFile, strategy_, labels);
+  binaryFile.close();
+}
+
+void Strategy::writeStrategyTable(std::ostream &out, const StrategyTable &table) {
+  for(const auto &step : table.getSteps()) {
     std::string line;
-    for(auto state : mapping.first.first) {
+    for(auto state : step.state) {
       line += std::to_string(state) + ",";
     }
 
     line.back() = ';';
-    line += std::to_string(mapping.first.second) + " -> " + std::to_string(mapping.second) + "\n";
-    stratFile << line;
+    line += std::to_string(step.currentAction) + " -> " + std::to_string(step.nextAction) + "\n";
+    out << line;
   }
-  stratFile.close();
+}
+
+bool Strategy::readStrategyTable(std::istream &in, StrategyTable &table) {
+  std::string line;
+  std::vector<struct StrategyStep> steps;
+  table.clear();
+
+  try {
+    while(std::getline(in, line)) {
+      if(line.empty() || line.rfind("//", 0)==0) {
+        continue;
+      }
+
+      auto stateEnd = line.find(';');
+      auto arrow = line.find(" -> ", stateEnd);
+      if(stateEnd==std::string::npos || arrow==std::string::npos) {
+        return false;
+      }
+
+      std::vector<int> state;
+      for(const auto &value : split(line.substr(0, stateEnd), ",")) {
+        state.push_back(std::stoi(value));
+      }
+
+      int currentAction = std::stoi(line.substr(stateEnd + 1, arrow - stateEnd - 1));
+      int nextAction = std::stoi(line.substr(arrow + 4));
+      steps.push_back({state, currentAction, nextAction});
+    }
+  } catch(std::exception &e) {
+    return false;
+  }
+
+  table = StrategyTable(steps);
+  return true;
+}
+
+namespace {
+/// Header of the binary strategy format, see Strategy::writeBinaryStrategyTable.
+struct BinaryStrategyHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t layout;
+  uint32_t laneCount;
+  int32_t actionCount;
+  uint32_t labelSize;
+  uint64_t mappings;
+};
+
+const char BINARY_STRATEGY_MAGIC[4] = {'A', 'S', 'S', 'T'};
+enum BinaryStrategyLayout : uint32_t { DENSE = 0, ROWS = 1 };
+
+/// Read exactly size bytes, False on a error or a short file.
+bool readBytes(int fd, char *data, size_t size) {
+  while(size > 0) {
+    ssize_t read = ::read(fd, data, size);
+    if(read==-1 && errno==EINTR) {
+      continue;
+    }
+    if(read <= 0) {
+      return false;
+    }
+    data += read;
+    size -= (size_t)read;
+  }
+  return true;
+}
+}
+
+void Strategy::writeBinaryStrategyTable(std::ostream &out, const StrategyTable &table,
+                                        const std::vector<std::string> &labels) {
+  bool dense = table.getActionCount() > 0;
+  auto laneCount = (uint32_t)table.getStateSpace().size();
+
+  std::string labelData;
+  for(const auto &label : labels) {
+    labelData += label;
+    labelData.push_back('\0');
+  }
+  // keeps the lanes and entries aligned in the mapped file
+  labelData.resize((labelData.size() + 7)/8*8, '\0');
+
+  std::string data;
+  struct BinaryStrategyHeader header{};
+  memcpy(header.magic, BINARY_STRATEGY_MAGIC, sizeof(header.magic));
+  header.version = STRATEGY_BINARY_VERSION;
+  header.layout = dense ? DENSE : ROWS;
+  header.laneCount = laneCount;
+  header.actionCount = dense ? table.getActionCount() : 0;
+  header.labelSize = (uint32_t)labelData.size();
+  header.mappings = table.size();
+  data.append((const char *)&header, sizeof(header));
+  data += labelData;
+
+  std::vector<int32_t> lanes(dense ? table.getBounds().begin() : table.getStateSpace().begin(),
+                             dense ? table.getBounds().end() : table.getStateSpace().end());
+  lanes.insert(lanes.end(), table.getStateSpace().begin(), table.getStateSpace().end());
+  data.append((const char *)lanes.data(), lanes.size()*sizeof(int32_t));
+
+  if(dense) {
+    const auto &entries = table.getEntries();
+    data.append((const char *)entries.data(), entries.size()*sizeof(uint16_t));
+  } else {
+    std::vector<int32_t> rows;
+    rows.reserve(table.size()*(laneCount + 2));
+    for(const auto &step : table.getSteps()) {
+      rows.insert(rows.end(), step.state.begin(), step.state.end());
+      rows.push_back(step.currentAction);
+      rows.push_back(step.nextAction);
+    }
+    data.append((const char *)rows.data(), rows.size()*sizeof(int32_t));
+  }
+
+  uint64_t checksum = hashBytes(data.data(), data.size());
+  out.write(data.data(), (std::streamsize)data.size());
+  out.write((const char *)&checksum, sizeof(checksum));
+}
+
+bool Strategy::loadBinaryStrategyTable(const std::string &filename, StrategyTable &table,
+                                       std::vector<std::string> &labels) {
+  int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if(fd==-1) {
+    return false;
+  }
+
+  struct stat buffer{};
+  if(fstat(fd, &buffer)!=0 || (size_t)buffer.st_size < sizeof(struct BinaryStrategyHeader) + sizeof(uint64_t)) {
+    close(fd);
+    return false;
+  }
+  size_t dataSize = (size_t)buffer.st_size - sizeof(uint64_t);
+  bool valid = false;
+
+  // the sizes are checked against the file before anything is read behind the header
+  struct BinaryStrategyHeader header{};
+  size_t offset = sizeof(header);
+  if(!readBytes(fd, (char *)&header, sizeof(header)) ||
+      memcmp(header.magic, BINARY_STRATEGY_MAGIC, sizeof(header.magic))!=0 ||
+      header.version!=STRATEGY_BINARY_VERSION ||
+      header.labelSize > dataSize - offset ||
+      (size_t)header.laneCount*2*sizeof(int32_t) > dataSize - offset - header.labelSize) {
+    close(fd);
+    return false;
+  }
+  uint64_t hash = hashBytes((const char *)&header, sizeof(header));
+
+  std::string labelData(header.labelSize, '\0');
+  std::vector<int32_t> lanes(header.laneCount*2);
+  size_t laneSize = lanes.size()*sizeof(int32_t);
+  if(readBytes(fd, &labelData[0], labelData.size()) && readBytes(fd, (char *)lanes.data(), laneSize)) {
+    hash = hashBytes(labelData.data(), labelData.size(), hash);
+    hash = hashBytes((const char *)lanes.data(), laneSize, hash);
+    offset += header.labelSize + laneSize;
+
+    std::vector<int> bounds(lanes.begin(), lanes.begin() + header.laneCount);
+    std::vector<int> maxState(lanes.begin() + header.laneCount, lanes.end());
+    size_t payloadSize = dataSize - offset;
+    uint64_t checksum;
+
+    if(header.layout==DENSE && payloadSize%sizeof(uint16_t)==0) {
+      // the entries are read into the vector the table takes over
+      std::vector<uint16_t> entries(payloadSize/sizeof(uint16_t));
+      if(readBytes(fd, (char *)entries.data(), payloadSize) && readBytes(fd, (char *)&checksum, sizeof(checksum)) &&
+          checksum==hashBytes((const char *)entries.data(), payloadSize, hash)) {
+        StrategyTable loaded;
+        valid = loaded.assignDense(bounds, header.actionCount, std::move(entries), header.mappings, maxState);
+        if(valid) {
+          table = std::move(loaded);
+        }
+      }
+    } else if(header.layout==ROWS) {
+      size_t rowSize = (header.laneCount + 2)*sizeof(int32_t);
+      if(payloadSize%rowSize==0 && payloadSize/rowSize==header.mappings) {
+        std::vector<int32_t> rows(payloadSize/sizeof(int32_t));
+        if(readBytes(fd, (char *)rows.data(), payloadSize) && readBytes(fd, (char *)&checksum, sizeof(checksum)) &&
+            checksum==hashBytes((const char *)rows.data(), payloadSize, hash)) {
+          std::vector<struct StrategyStep> steps;
+          steps.reserve(header.mappings);
+          for(auto row = rows.begin(); row!=rows.end(); row += header.laneCount + 2) {
+            steps.push_back({std::vector<int>(row, row + header.laneCount),
+                             row[header.laneCount], row[header.laneCount + 1]});
+          }
+          table = StrategyTable(steps);
+          valid = true;
+        }
+      }
+    }
+
+    if(valid) {
+      labels.clear();
+      for(size_t begin = 0, end; begin < labelData.size(); begin = end + 1) {
+        end = labelData.find('\0', begin);
+        if(end==std::string::npos) {
+          end = labelData.size();
+        }
+        if(end > begin) {
+          labels.push_back(labelData.substr(begin, end - begin));
+        }
+      }
+    }
+  }
+
+  close(fd);
+  return valid;
 }
 
 void Strategy::loadSchedFile() {
@@ -84,20 +654,92 @@ void Strategy::loadSchedFile() {
 
   std::ifstream schedFile;
   schedFile.open(out_path_ + filePrefix + ".sched");
+  loadSched(schedFile);
+  schedFile.close();
+}
+
+void Strategy::loadSched(std::istream &in) {
+  assert(check());
+
   std::string line;
 
   std::vector<int> state;
   int currentAction = -1;
   int nextAction = -1;
 
-  strategy_.clear();
-  while(std::getline(schedFile, line)) {
+  std::vector<struct StrategyStep> steps;
+  while(std::getline(in, line)) {
     if(parseSchedFileLine(line, state, currentAction, nextAction)) {
-      addStrategyStep(state, currentAction, nextAction);
+      steps.push_back({state, currentAction, nextAction});
     }
   }
+  strategy_ = StrategyTable(steps);
+  resetFallbacks();
+}
 
-  schedFile.close();
+bool Strategy::loadExplicitSched(std::istream &in, const std::vector<int> &modelStateSpace, size_t actionCount) {
+  assert(check());
+
+  std::string line;
+  std::vector<int> state(modelStateSpace.size());
+  bool parsed = true;
+
+  strategy_ = StrategyTable(modelStateSpace, (int)actionCount);
+  while(std::getline(in, line)) {
+    if(line.empty() || !std::isdigit(line[0])) {
+      continue;
+    }
+
+    // STATE : CHOICE {LABEL}
+    char *end;
+    errno = 0;
+    size_t index = std::strtoul(line.c_str(), &end, 10);
+    size_t separator = line.find(':');
+    if(errno!=0 || separator==std::string::npos || line.find_first_not_of(" \t", end - line.c_str())!=separator) {
+      parsed = false;
+      continue;
+    }
+
+    // only the shield move (move=2) has a choice
+    if(index%3!=2) {
+      continue;
+    }
+    index /= 3;
+    int currentAction = (int)(index%actionCount);
+    index /= actionCount;
+    for(size_t i = 0; i < modelStateSpace.size(); i++) {
+      state[i] = (int)(index%(modelStateSpace[i] + 1));
+      index /= modelStateSpace[i] + 1;
+    }
+
+    // choice label (action label) if exported, the choice index otherwise
+    std::string choice = getSubstrBetweenDelims(line, "{", "}");
+    size_t digits = choice.find_first_of("0123456789");
+    if(!choice.empty() && digits!=std::string::npos) {
+      choice = choice.substr(digits);
+    } else if(choice.empty()) {
+      choice = line.substr(separator + 1);
+      choice = choice.substr(0, choice.find('{'));
+    }
+
+    int nextAction;
+    size_t length = 0;
+    try {
+      nextAction = std::stoi(choice, &length);
+    } catch(std::exception &e) {
+      parsed = false;
+      continue;
+    }
+    if(nextAction < 0 || (size_t)nextAction >= actionCount ||
+        choice.find_first_not_of(" \t", length)!=std::string::npos) {
+      parsed = false;
+      continue;
+    }
+
+    strategy_.set(state, currentAction, nextAction);
+  }
+  resetFallbacks();
+  return parsed;
 }
 
 bool Strategy::parseSchedFileLine(const std::string &line,
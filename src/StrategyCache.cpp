@@ -0,0 +1,215 @@
+#include <fstream>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <experimental/filesystem>
+
+#include "StrategyCache.h"
+#include "Util.h"
+
+bool StrategyCache::lookup(const std::string &key, StrategyTable &table) {
+  auto it = index.find(key);
+  if(it!=index.end()) {
+    // move to front, most recently used
+    entries.splice(entries.begin(), entries, it->second);
+    table = it->second->second;
+    hits++;
+    return true;
+  }
+
+  if(loadFromDisk(key, table)) {
+    entries.emplace_front(key, table);
+    index[key] = entries.begin();
+    while(entries.size() > capacity) {
+      index.erase(entries.back().first);
+      entries.pop_back();
+    }
+
+    hits++;
+    diskHits++;
+    return true;
+  }
+
+  misses++;
+  return false;
+}
+
+void StrategyCache::insert(const std::string &key, const StrategyTable &table) {
+  if(key.empty() || table.empty()) {
+    return;
+  }
+
+  storeToDisk(key, table);
+
+  auto it = index.find(key);
+  if(it!=index.end()) {
+    it->second->second = table;
+    entries.splice(entries.begin(), entries, it->second);
+    return;
+  }
+
+  entries.emplace_front(key, table);
+  index[key] = entries.begin();
+
+  while(entries.size() > capacity) {
+    index.erase(entries.back().first);
+    entries.pop_back();
+  }
+}
+
+size_t StrategyCache::getHits() const {
+  return hits;
+}
+
+size_t StrategyCache::getDiskHits() const {
+  return diskHits;
+}
+
+size_t StrategyCache::getMisses() const {
+  return misses;
+}
+
+std::string StrategyCache::getCacheFile(const std::string &key) {
+  if(gConfig.cacheDir.empty()) {
+    return std::string();
+  }
+  return gConfig.cacheDir + "/" + key + ".bstrat";
+}
+
+std::vector<std::string> StrategyCache::getPositionLabels(size_t laneCount) {
+  std::vector<std::string> labels;
+  for(size_t i = 0; i < laneCount; i++) {
+    labels.push_back("lane" + std::to_string(i));
+  }
+  return labels;
+}
+
+bool StrategyCache::loadFromDisk(const std::string &key, StrategyTable &table) {
+  std::string filename = getCacheFile(key);
+  if(filename.empty()) {
+    return false;
+  }
+
+  if(access(filename.c_str(), F_OK)!=0) {
+    return false;
+  }
+
+  // the model key replaces the labels by their position, so the file holds positions and only
+  // the number and order of the lanes are checked, the names differ between junctions
+  std::vector<std::string> labels;
+  if(!Strategy::loadBinaryStrategyTable(filename, table, labels) || table.empty() ||
+      labels!=getPositionLabels(table.getStateSpace().size())) {
+    std::cerr << "Strategy cache file " << filename << " is corrupted and will be removed." << std::endl;
+    unlink(filename.c_str());
+    return false;
+  }
+
+  // mark as recently used for the eviction
+  utimensat(AT_FDCWD, filename.c_str(), nullptr, 0);
+  return true;
+}
+
+void StrategyCache::storeToDisk(const std::string &key, const StrategyTable &table) {
+  std::string filename = getCacheFile(key);
+  if(filename.empty()) {
+    return;
+  }
+
+  std::error_code error;
+  std::experimental::filesystem::create_directories(gConfig.cacheDir, error);
+
+  if(access(filename.c_str(), F_OK)==0) {
+    // solved by a parallel run in the meantime
+    utimensat(AT_FDCWD, filename.c_str(), nullptr, 0);
+    return;
+  }
+
+  // readers never see a partial file, rename is atomic in the same directory
+  std::string tmpFilename = gConfig.cacheDir + "/." + key + "." + std::to_string(getpid()) + ".tmp";
+  std::ofstream cacheFile(tmpFilename, std::ios::trunc | std::ios::binary);
+  Strategy::writeBinaryStrategyTable(cacheFile, table, getPositionLabels(table.getStateSpace().size()));
+  long long storedSize = cacheFile.tellp();
+  cacheFile.close();
+
+  if(cacheFile.fail() || rename(tmpFilename.c_str(), filename.c_str())!=0) {
+    std::cerr << "Could not write strategy cache file " << filename << std::endl;
+    unlink(tmpFilename.c_str());
+    return;
+  }
+
+  evictFromDisk(storedSize);
+}
+
+void StrategyCache::evictFromDisk(long long storedSize) {
+  long long maxSize = (long long)gConfig.cacheDirSize*1024*1024;
+  if(diskSize >= 0) {
+    diskSize += std::max(storedSize, 0LL);
+  }
+  // parallel processes store files as well, the directory is scanned from time to time
+  if(diskSize >= 0 && diskSize <= maxSize && ++diskInserts < CACHE_DIR_SCAN_INTERVAL) {
+    return;
+  }
+
+  std::string lockFilename = gConfig.cacheDir + "/.lock";
+  int lock = open(lockFilename.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+  if(lock==-1) {
+    return;
+  }
+
+  // another process is already evicting
+  if(flock(lock, LOCK_EX | LOCK_NB)!=0) {
+    close(lock);
+    return;
+  }
+
+  struct cacheFileInfo {
+    std::string path;
+    off_t size;
+    time_t lastUse;
+  };
+
+  std::vector<struct cacheFileInfo> files;
+  long long totalSize = 0;
+
+  std::error_code error;
+  for(std::experimental::filesystem::directory_iterator it(gConfig.cacheDir, error), end; !error && it!=end;
+      it.increment(error)) {
+    std::string path = it->path().string();
+    // .strat files of older versions are evicted as well
+    if(it->path().extension()!=".bstrat" && it->path().extension()!=".strat") {
+      continue;
+    }
+
+    struct stat buffer{};
+    if(stat(path.c_str(), &buffer)!=0) {
+      // removed by another process
+      continue;
+    }
+
+    files.push_back({path, buffer.st_size, buffer.st_mtime});
+    totalSize += buffer.st_size;
+  }
+
+  if(totalSize > maxSize) {
+    std::sort(files.begin(), files.end(), [](const struct cacheFileInfo &a, const struct cacheFileInfo &b) {
+      return a.lastUse < b.lastUse;
+    });
+
+    // evict below the limit, by that the next inserts fit without a scan
+    long long targetSize = maxSize - maxSize/10;
+    for(const auto &file : files) {
+      if(totalSize <= targetSize) {
+        break;
+      }
+      unlink(file.path.c_str());
+      totalSize -= file.size;
+    }
+  }
+  diskSize = totalSize;
+  diskInserts = 0;
+
+  flock(lock, LOCK_UN);
+  close(lock);
+}
@@ -0,0 +1,190 @@
+#include <cmath>
+#include <iostream>
+
+#include "SynthesisBackend.h"
+#include "STORMConnector.h"
+#include "Util.h"
+
+std::unique_ptr<SynthesisBackend> SynthesisBackend::create(const std::string &name) {
+  if(name=="native") {
+    return std::unique_ptr<SynthesisBackend>(new NativeBackend());
+  }
+
+  if(name.compare(0, 5, "storm")!=0 || (name.size() > 5 && name[5]!=':')) {
+    return nullptr;
+  }
+
+  // storm[:engine[:method]]
+  std::string engine;
+  std::string method;
+  if(name.size() > 5) {
+    std::string settings = name.substr(6);
+    size_t separator = settings.find(':');
+    engine = settings.substr(0, separator);
+    if(separator!=std::string::npos) {
+      method = settings.substr(separator + 1);
+      if(method.empty() || method.find(':')!=std::string::npos) {
+        return nullptr;
+      }
+    }
+  }
+
+  if(!engine.empty() && engine!="sparse" && engine!="hybrid" && engine!="dd") {
+    return nullptr;
+  }
+
+  return std::unique_ptr<SynthesisBackend>(new StormBackend(engine, method));
+}
+
+StormBackend::StormBackend(std::string engine, std::string method)
+    : engine(std::move(engine)), method(std::move(method)) {}
+
+std::string StormBackend::getName() const {
+  std::string name = "storm";
+  if(!engine.empty() || !method.empty()) {
+    name += ":" + engine;
+  }
+  if(!method.empty()) {
+    name += ":" + method;
+  }
+  return name;
+}
+
+bool StormBackend::isInProcess() const {
+  return false;
+}
+
+std::vector<std::string> StormBackend::getCommand(const struct STORMModel &model, const std::string &modelPath,
+                                                  const std::string &schedPath) const {
+  bool explicitModel = !model.explicitModel.labels.empty();
+
+  std::vector<std::string> vecArgs{"/usr/bin/storm"};
+  if(explicitModel) {
+    vecArgs.push_back("--explicit-drn");
+    vecArgs.push_back(modelPath);
+  } else {
+    vecArgs.push_back("--prism");
+    vecArgs.push_back(modelPath);
+    if(!model.constants.empty()) {
+      vecArgs.push_back("--constants");
+      vecArgs.push_back(model.constants);
+    }
+  }
+  vecArgs.push_back("--prop");
+  vecArgs.push_back(model.properties);
+  vecArgs.push_back("--exportscheduler");
+  vecArgs.push_back(schedPath);
+  if(!explicitModel) {
+    vecArgs.push_back("--buildstateval");
+    vecArgs.push_back("--buildchoicelab");
+  }
+  if(!engine.empty()) {
+    vecArgs.push_back("--engine");
+    vecArgs.push_back(engine);
+  }
+  if(!method.empty()) {
+    vecArgs.push_back("--minmax:method");
+    vecArgs.push_back(method);
+  }
+  vecArgs.push_back("--timeout");
+  vecArgs.push_back(std::to_string(gConfig.synthesisTimeout));
+
+  return vecArgs;
+}
+
+std::string NativeBackend::getName() const {
+  return "native";
+}
+
+bool NativeBackend::isInProcess() const {
+  return true;
+}
+
+std::vector<std::string> NativeBackend::getCommand(const struct STORMModel &, const std::string &,
+                                                   const std::string &) const {
+  return {};
+}
+
+std::string BackendCalibration::select(size_t states) {
+  if(gConfig.backend!="auto") {
+    return gConfig.backend;
+  }
+
+  size_t sizeClass = getSizeClass(states);
+  auto &calibrations = classes[sizeClass];
+
+  // calibrate the backends in turn, the order of --calibration-backends keeps it deterministic
+  std::string next;
+  size_t fewest = CALIBRATION_RUNS;
+  for(const auto &backend : gConfig.calibrationBackends) {
+    const auto &calibration = calibrations[backend];
+    if(!calibration.failed && calibration.assigned < fewest) {
+      next = backend;
+      fewest = calibration.assigned;
+    }
+  }
+  if(!next.empty()) {
+    calibrations[next].assigned++;
+    return next;
+  }
+
+  std::string fastest = getFastest(sizeClass);
+  if(fastest.empty()) {
+    // calibration runs are still pending or all backends failed
+    return gConfig.calibrationBackends.front();
+  }
+
+  if(choices[sizeClass]!=fastest) {
+    choices[sizeClass] = fastest;
+    std::cout << "Calibration: models with 1e" << sizeClass << " states use " << fastest << std::endl;
+  }
+  return fastest;
+}
+
+void BackendCalibration::record(const std::string &backend, size_t states, bool success, double wallTime) {
+  if(gConfig.backend!="auto") {
+    return;
+  }
+
+  auto &calibration = classes[getSizeClass(states)][backend];
+  if(!success) {
+    calibration.failed = true;
+    return;
+  }
+
+  // mean over the calibration runs and the later runs of the chosen backend
+  double sample = wallTime/std::max<size_t>(states, 1);
+  calibration.measured++;
+  calibration.timePerState += (sample - calibration.timePerState)/calibration.measured;
+}
+
+size_t BackendCalibration::getSizeClass(size_t states) {
+  return states > 0 ? (size_t)std::log10((double)states) : 0;
+}
+
+std::string BackendCalibration::getFastest(size_t sizeClass) const {
+  auto calibrations = classes.find(sizeClass);
+  if(calibrations==classes.end()) {
+    return "";
+  }
+
+  std::string fastest;
+  double best = 0.;
+  for(const auto &backend : gConfig.calibrationBackends) {
+    auto calibration = calibrations->second.find(backend);
+    if(calibration==calibrations->second.end() || calibration->second.failed || calibration->second.measured==0) {
+      continue;
+    }
+    if(fastest.empty() || calibration->second.timePerState < best) {
+      fastest = backend;
+      best = calibration->second.timePerState;
+    }
+  }
+  return fastest;
+}
+
+void BackendCalibration::printSummary(std::ostream &out) const {
+  for(const auto &choice : choices) {
+    out << "Synthesis backend : models with 1e" << choice.first << " states - " << choice.second << std::endl;
+  }
+}
@@ -0,0 +1,120 @@
+#include <iostream>
+
+#include "SynthesisProtocol.h"
+#include "../lib/json.hpp"
+
+using json = nlohmann::json;
+
+std::string encodeRequest(const struct STORMModel &model) {
+  json request;
+  request["key"] = model.key;
+  request["prism"] = model.prism;
+  if(!model.constants.empty()) {
+    request["constants"] = model.constants;
+  }
+  request["properties"] = model.properties;
+  request["labels"] = model.labels;
+  request["states"] = model.states;
+  if(!model.backend.empty()) {
+    request["backend"] = model.backend;
+  }
+
+  if(!model.explicitModel.labels.empty()) {
+    json explicitModel;
+    explicitModel["labels"] = model.explicitModel.labels;
+    explicitModel["state_space"] = model.explicitModel.stateSpace;
+    explicitModel["lane_probabilities"] = model.explicitModel.laneProbabilities;
+    explicitModel["action_labels"] = model.explicitModel.actionLabels;
+    explicitModel["action_probabilities"] = model.explicitModel.actionProbabilities;
+    explicitModel["ways"] = model.explicitModel.ways;
+    request["explicit"] = explicitModel;
+  }
+
+  return request.dump() + "\n";
+}
+
+bool decodeRequest(const std::string &line, struct STORMModel &model) {
+  try {
+    json request = json::parse(line);
+    model.key = request.at("key").get<std::string>();
+    model.prism = request.at("prism").get<std::string>();
+    model.constants = request.value("constants", std::string());
+    model.properties = request.at("properties").get<std::string>();
+    model.labels = request.at("labels").get<std::vector<std::string>>();
+    model.states = request.at("states").get<size_t>();
+    model.backend = request.value("backend", std::string());
+
+    if(request.contains("explicit")) {
+      const auto &explicitModel = request["explicit"];
+      model.explicitModel.labels = explicitModel.at("labels").get<std::vector<std::string>>();
+      model.explicitModel.stateSpace = explicitModel.at("state_space").get<std::vector<int>>();
+      model.explicitModel.laneProbabilities = explicitModel.at("lane_probabilities").get<std::vector<float>>();
+      model.explicitModel.actionLabels = explicitModel.at("action_labels").get<std::vector<std::string>>();
+      model.explicitModel.actionProbabilities = explicitModel.at("action_probabilities").get<std::vector<float>>();
+      model.explicitModel.ways = explicitModel.at("ways").get<std::vector<std::vector<size_t>>>();
+    }
+  } catch(std::exception &e) {
+    std::cerr << "Invalid synthesis request: " << e.what() << std::endl;
+    return false;
+  }
+
+  return !model.key.empty();
+}
+
+std::string encodeResponse(const struct SynthesisRecord &record, const StrategyTable &table) {
+  json response;
+  response["model"] = record.modelKey;
+  response["outcome"] = record.outcome;
+  response["exit_code"] = record.exitCode;
+  response["wall_time"] = record.wallTime;
+  response["cpu_time"] = record.cpuTime;
+  response["peak_rss_kb"] = record.peakRSS;
+  response["states"] = record.states;
+  response["transitions"] = record.transitions;
+  response["choices"] = record.choices;
+
+  json rows = json::array();
+  for(const auto &step : table.getSteps()) {
+    std::vector<int> row = step.state;
+    row.push_back(step.currentAction);
+    row.push_back(step.nextAction);
+    rows.push_back(row);
+  }
+  response["table"] = rows;
+
+  return response.dump() + "\n";
+}
+
+bool decodeResponse(const std::string &line, struct SynthesisRecord &record, StrategyTable &table) {
+  try {
+    json response = json::parse(line);
+    record.modelKey = response.at("model").get<std::string>();
+    record.outcome = response.at("outcome").get<std::string>();
+    record.exitCode = response.at("exit_code").get<int>();
+    record.wallTime = response.at("wall_time").get<double>();
+    record.cpuTime = response.at("cpu_time").get<double>();
+    record.peakRSS = response.at("peak_rss_kb").get<long>();
+    record.states = response.at("states").get<size_t>();
+    record.transitions = response.at("transitions").get<size_t>();
+    record.choices = response.at("choices").get<size_t>();
+
+    std::vector<struct StrategyStep> steps;
+    for(const auto &row : response.at("table")) {
+      auto values = row.get<std::vector<int>>();
+      if(values.size() < 2) {
+        return false;
+      }
+      int nextAction = values.back();
+      values.pop_back();
+      int action = values.back();
+      values.pop_back();
+      steps.push_back({values, action, nextAction});
+    }
+    table = StrategyTable(steps);
+  } catch(std::exception &e) {
+    std::cerr << "Invalid synthesis response: " << e.what() << std::endl;
+    return false;
+  }
+
+  return true;
+}
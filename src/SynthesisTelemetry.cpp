@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "SynthesisTelemetry.h"
+#include "Util.h"
+#include "../lib/json.hpp"
+
+using json = nlohmann::json;
+
+void SynthesisTelemetry::record(const struct SynthesisRecord &record) {
+  jobs++;
+  if(record.outcome=="success") {
+    succeeded++;
+  } else {
+    failed++;
+  }
+  if(record.outcome=="timeout") {
+    timeouts++;
+  }
+  if(record.speculative) {
+    speculative++;
+  }
+  wallTime += record.wallTime;
+  cpuTime += record.cpuTime;
+  peakRSS = std::max(peakRSS, record.peakRSS);
+  states += record.states;
+
+  if(gConfig.telemetryFile.empty()) {
+    return;
+  }
+
+  if(!file.is_open()) {
+    file.open(gConfig.telemetryFile, std::ios::app);
+    if(!file.is_open()) {
+      std::cerr << "Could not open telemetry file " << gConfig.telemetryFile << std::endl;
+      gConfig.telemetryFile.clear();
+      return;
+    }
+  }
+
+  json line;
+  line["time"] = getTimeString();
+  line["junction"] = record.junction;
+  line["model"] = record.modelKey;
+  line["backend"] = record.backend;
+  line["speculative"] = record.speculative;
+  line["outcome"] = record.outcome;
+  line["exit_code"] = record.exitCode;
+  line["wall_time"] = record.wallTime;
+  line["cpu_time"] = record.cpuTime;
+  line["peak_rss_kb"] = record.peakRSS;
+  line["states"] = record.states;
+  line["transitions"] = record.transitions;
+  line["choices"] = record.choices;
+  line["predicted_states"] = record.predictedStates;
+
+  file << line.dump() << "\n";
+  file.flush();
+}
+
+void SynthesisTelemetry::parseModelSize(const std::string &output, struct SynthesisRecord &record) {
+  auto parse = [&output](const std::string &token) -> size_t {
+    size_t position = output.find(token);
+    if(position==std::string::npos) {
+      return 0;
+    }
+
+    std::istringstream value(output.substr(position + token.size(), 32));
+    size_t number = 0;
+    value >> number;
+    return number;
+  };
+
+  record.states = parse("States:");
+  record.transitions = parse("Transitions:");
+  record.choices = parse("Choices:");
+}
+
+void SynthesisTelemetry::printSummary(std::ostream &out) const {
+  auto flags = out.flags();
+  auto precision = out.precision();
+  out << std::fixed << std::setprecision(2);
+  out << "Synthesis jobs : " << jobs << " (" << succeeded << " succeeded, " << failed << " failed, "
+      << timeouts << " timeouts, " << speculative << " speculative)"
+      << " - wall time : " << wallTime << "s - CPU time : " << cpuTime << "s"
+      << " - peak RSS : " << peakRSS/1024. << " MB - states : " << states << std::endl;
+  out.flags(flags);
+  out.precision(precision);
+}
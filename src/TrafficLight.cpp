@@ -14,7 +14,6 @@ TrafficLight *TrafficLight::build(SUMOConnector *sumo, const std::string &tlsID)
   assert(t->getShield()!=nullptr);
 
   t->getShield()->writeJson();
-  t->getShield()->createStrategy();
   t->getShield()->printConfig();
   t->logHeader();
 
@@ -35,7 +34,6 @@ TrafficLight *TrafficLight::buildFromFile(SUMOConnector *sumo, const std::string
   t->getShield()->readJson();
   // write the config back if some orders are corrected.
   t->getShield()->writeJson();
-  t->getShield()->createStrategy();
   t->getShield()->printConfig();
   t->logHeader();
 
@@ -133,6 +131,10 @@ Shield *TrafficLight::getShield() {
   return shield_;
 }
 
+void TrafficLight::setUpdateOffset(size_t offset) {
+  updateOffset = offset;
+}
+
 void TrafficLight::step() {
   if(getShield()==nullptr || !getShield()->state()) {
     return;
@@ -146,7 +148,7 @@ void TrafficLight::step() {
   int deviation = 0;
 
   size_t timeStep = sumo_->getTimeStep();
-  if(timeStep > warmUpTime && timeStep%updateInterval==0 && sumo_->getVehicleIDs().size()) {
+  if(timeStep > warmUpTime && timeStep%updateInterval==updateOffset && sumo_->getVehicleIDs().size()) {
     getShield()->update();
     std::cout << timeStep << ": " << getShield()->logConfig() << std::endl;
     shieldUpdated = true;
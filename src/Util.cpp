@@ -5,11 +5,17 @@
 #include <fstream>
 #include <fcntl.h>
 #include <iostream>
+#include <sstream>
 #include <wait.h>
+#include <spawn.h>
+#include <csignal>
+#include <unistd.h>
+#include <sys/syscall.h>
 #include <boost/program_options.hpp>
 #include <boost/algorithm/string/trim.hpp>
 
 #include "Util.h"
+#include "SynthesisBackend.h"
 
 struct configInfo gConfig;
 
@@ -94,6 +100,7 @@ void parse_args(int argc, char *argv[], struct configInfo &config) {
   std::string blockFile;
   std::vector<std::string> ignoreFiles;
   std::vector<std::string> shieldIDFile;
+  std::string calibrationBackends;
 
   try {
     boost::program_options::options_description desc("Allowed options");
@@ -117,14 +124,56 @@ void parse_args(int argc, char *argv[], struct configInfo &config) {
             "Time step until stop the simulation.")
         ("warm-up-time,x", boost::program_options::value(&config.warmUpTime),
             "Time step until the shield starts to intervene.")
+        ("synthesis-jobs", boost::program_options::value(&config.synthesisJobs),
+            "Max. number of concurrent STORM processes and native solver threads.")
+        ("synthesis-timeout", boost::program_options::value(&config.synthesisTimeout),
+            "Wall clock time limit of a strategy synthesis in seconds.")
+        ("synthesis-memory", boost::program_options::value(&config.synthesisMemory),
+            "Memory limit of a strategy synthesis in MB (0 disables the limit).")
+        ("state-budget", boost::program_options::value(&config.stateBudget),
+            "Max. number of model states per junction, limits the state space growth (0 disables the limit).")
+        ("time-budget", boost::program_options::value(&config.timeBudget),
+            "Max. synthesis time per junction in seconds, limits the state space growth (0 disables the limit).")
+        ("sub-shield-lanes", boost::program_options::value(&config.subShieldLanes),
+            "Split junctions with more lanes into sub-shields of lane groups (0 disables the split).")
         ("gui,g", "Use sumo-gui.")
         ("free,f", "Run without Shields.")
         ("bus", "Prioritize public transport.")
         ("no-lane-merging", "Avoid the merging of parallel lanes.")
         ("static-update", "Do shield updates in static interval no Minimum change for update required.")
+        ("stagger-updates", "Spread the shield updates of the junctions evenly over the update interval.")
         ("no-lane-trees", "Disable accurate lane state for non OSM Maps.")
         ("side-by-side", "Run a shielded and unshielded simulation simulations.")
         ("hook-sumo", "Connect to external started SUMO.")
+        ("async-update", "Do shield updates in background, the old strategy stays active until STORM finished.")
+        ("lazy-shields",
+         "Skip the initial synthesis, shields load cached strategies or synthesize after the warm up time.")
+        ("speculative", "Synthesize strategies for the next state space sizes while STORM is idle.")
+        ("synthesis-backend", boost::program_options::value(&config.backend),
+            "Strategy synthesis: storm, storm:ENGINE[:METHOD] (sparse, hybrid or dd engine, --minmax:method), "
+            "native (in-process solver on a worker thread) or auto (calibrate the backends per model size).")
+        ("calibration-backends", boost::program_options::value(&calibrationBackends),
+            "Comma separated backends calibrated by --synthesis-backend auto.")
+        ("symmetry-reduction", "Solve the quotient model of interchangeable lanes (native backend).")
+        ("synthd", boost::program_options::value(&config.synthdSocket),
+            "Unix socket of a synthesis worker (adaptiveShielding-synthd), STORM runs in the worker.")
+        ("explicit-drn", "Hand the model to STORM in the explicit DRN format instead of the PRISM program "
+                         "(default modules only, modules of a shield config file keep the PRISM program).")
+        ("parametric-model",
+         "Generate the PRISM program of a junction once, STORM gets the probabilities and lane sizes as constants.")
+        ("telemetry", boost::program_options::value(&config.telemetryFile),
+            "Append a JSON line with the measurements of every strategy synthesis to the file and print a summary.")
+        ("no-strategy-cache", "Always run STORM, also for models which are already solved.")
+        ("cache-dir", boost::program_options::value(&config.cacheDir),
+            "Directory to share solved strategies between runs.")
+        ("cache-size", boost::program_options::value(&config.cacheDirSize),
+            "Size limit of the cache directory in MB.")
+        ("quantization", boost::program_options::value(&config.quantization),
+            "Step size to quantize the model probabilities (0 disables the quantization).")
+        ("quantization-mode", boost::program_options::value(&config.quantizationMode),
+            "Quantization mode: grid or lattice.")
+        ("debug-files",
+         "Write the PRISM, properties, scheduler and strategy files to out/ and print the strategy statistics.")
         ("overwrite-controller",
          "Overwrite the traffic light controller (RL Agent) with the shield strategy "
          "and reset to previous action if the overwritten controller takes not the control back.")
@@ -144,11 +193,20 @@ void parse_args(int argc, char *argv[], struct configInfo &config) {
     config.sideBySide = vm.count("side-by-side") ? true : false;
     config.noMerging = vm.count("no-lane-merging") ? true : false;
     config.staticUpdate = vm.count("static-update") ? true : false;
+    config.staggerUpdates = vm.count("stagger-updates") ? true : false;
     config.gui = vm.count("gui") ? true : false;
     config.prioritizeBus = vm.count("bus") ? true : false;
     config.noTrees = vm.count("no-lane-trees") ? true : false;
     config.client = vm.count("hook-sumo") ? true : false;
     config.overwrite = vm.count("overwrite-controller") ? true : false;
+    config.asyncUpdate = vm.count("async-update") ? true : false;
+    config.noStrategyCache = vm.count("no-strategy-cache") ? true : false;
+    config.debugFiles = vm.count("debug-files") ? true : false;
+    config.explicitModel = vm.count("explicit-drn") ? true : false;
+    config.parametricModel = vm.count("parametric-model") ? true : false;
+    config.speculative = vm.count("speculative") ? true : false;
+    config.lazyShields = vm.count("lazy-shields") ? true : false;
+    config.symmetryReduction = vm.count("symmetry-reduction") ? true : false;
   }
   catch(std::exception &e) {
     std::cout << e.what() << "\n";
@@ -160,6 +218,56 @@ void parse_args(int argc, char *argv[], struct configInfo &config) {
     exit(1);
   }
 
+  if(config.backend!="auto" && SynthesisBackend::create(config.backend)==nullptr) {
+    std::cerr << "Unknown synthesis backend " << config.backend << "\n";
+    exit(1);
+  }
+
+  if(!calibrationBackends.empty()) {
+    config.calibrationBackends.clear();
+    std::stringstream backends(calibrationBackends);
+    std::string backend;
+    while(std::getline(backends, backend, ',')) {
+      if(SynthesisBackend::create(backend)==nullptr) {
+        std::cerr << "Unknown synthesis backend " << backend << "\n";
+        exit(1);
+      }
+      config.calibrationBackends.push_back(SynthesisBackend::create(backend)->getName());
+    }
+    if(config.calibrationBackends.empty()) {
+      std::cerr << "No calibration backends\n";
+      exit(1);
+    }
+  }
+
+  if(config.quantizationMode!="grid" && config.quantizationMode!="lattice") {
+    std::cerr << "Unknown quantization mode " << config.quantizationMode << "\n";
+    exit(1);
+  }
+
+  if(config.quantization < 0. || config.quantization >= 1.) {
+    std::cerr << "Quantization step size has to be in [0, 1)\n";
+    exit(1);
+  }
+
+  if(config.synthesisMemory > 0 && access(PRLIMIT_PATH, X_OK)!=0) {
+    std::cerr << "The synthesis memory limit needs " << PRLIMIT_PATH << " (util-linux)\n";
+    exit(1);
+  }
+
+  if(config.synthesisJobs < 1) {
+    config.synthesisJobs = 1;
+  }
+
+  if(config.synthesisTimeout < 1) {
+    config.synthesisTimeout = 1;
+  }
+
+  if(config.timeBudget < 0.) {
+    std::cerr << "Time budget " << config.timeBudget << " is negative, disable the time budget.\n";
+    config.timeBudget = 0.;
+  }
+
   if(!blockFile.empty() && fileExist(blockFile)) {
     std::cerr << "block File " << blockFile << " does not exist\n";
     exit(1);
@@ -199,50 +307,97 @@ void parse_args(int argc, char *argv[], struct configInfo &config) {
   }
 }
 
-void pythonPlot(const std::vector<char *> &logFiles) {
-  pid_t pid, w;
-  pid = fork();
-  int waitStatus;
-  if(pid==-1) {
-    std::cerr << "Could not fork to start python\n";
+struct processInfo spawnProcess(const std::vector<std::string> &args,
+                                const std::string &logFile,
+                                int logFd,
+                                const std::vector<int> &inheritFds) {
+  struct processInfo process;
+
+  std::vector<char *> argv;
+  for(const auto &arg : args) {
+    argv.push_back(const_cast<char *>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  if(logFd!=-1) {
+    posix_spawn_file_actions_adddup2(&actions, logFd, STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, logFd, STDERR_FILENO);
+  } else if(!logFile.empty()) {
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, logFile.c_str(), O_RDWR | O_CREAT | O_APPEND,
+                                     S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH);
+    posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+  }
+  // a dup2 onto the same descriptor clears close-on-exec
+  for(int fd : inheritFds) {
+    posix_spawn_file_actions_adddup2(&actions, fd, fd);
   }
 
-  if(pid==0) {
-    std::vector<char *> args;
-    args.push_back(const_cast<char *>("/usr/bin/python3"));
-    args.push_back(const_cast<char *>("plot.py"));
-    for(auto &logFile : logFiles)
-      args.push_back(logFile);
-    args.push_back(NULL);
+  posix_spawnattr_t attributes;
+  posix_spawnattr_init(&attributes);
+  sigset_t defaultSignals;
+  sigemptyset(&defaultSignals);
+  sigaddset(&defaultSignals, SIGPIPE);
+  posix_spawnattr_setsigdefault(&attributes, &defaultSignals);
+  posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGDEF);
+
+  int error = posix_spawn(&process.pid, argv[0], &actions, &attributes, argv.data(), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attributes);
+  if(error!=0) {
+    errno = error;
+    process.pid = -1;
+    return process;
+  }
 
-    int fd = open("python.log", O_RDWR | O_CREAT | O_APPEND,
-                  S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH);
+#ifdef SYS_pidfd_open
+  process.pidfd = (int)syscall(SYS_pidfd_open, process.pid, 0);
+#endif
+  return process;
+}
 
-    dup2(fd, STDOUT_FILENO);
-    dup2(fd, STDERR_FILENO);
+pid_t waitProcess(struct processInfo &process, int &waitStatus, int options, struct rusage *usage) {
+  pid_t w = wait4(process.pid, &waitStatus, options, usage);
+  if(w==process.pid && (WIFEXITED(waitStatus) || WIFSIGNALED(waitStatus)) && process.pidfd!=-1) {
+    close(process.pidfd);
+    process.pidfd = -1;
+  }
+  return w;
+}
+
+void pythonPlot(const std::vector<char *> &logFiles) {
+  std::vector<std::string> args{"/usr/bin/python3", "plot.py"};
+  for(auto &logFile : logFiles)
+    args.emplace_back(logFile);
 
-    execv(args[0], args.data());
+  struct processInfo process = spawnProcess(args, "python.log");
+  if(process.pid==-1) {
     perror("PYTHON NOT STARTED!\n");
-  } else {
-    do {
-      w = waitpid(pid, &waitStatus, WUNTRACED | WCONTINUED);
-      if(w==-1) {
-        std::cerr << "Could not wait for process\n";
-      }
-      if(WIFEXITED(waitStatus) && waitStatus==0) {
-        std::cout << "python succeed\n";
-      } else if(waitStatus!=0) {
-        std::cerr << "python did not succeed\n";
-        exit(0);
-      } else if(WIFSIGNALED(waitStatus)) {
-        printf("killed by signal %d\n", WTERMSIG(waitStatus));
-      } else if(WIFSTOPPED(waitStatus)) {
-        printf("stopped by signal %d\n", WSTOPSIG(waitStatus));
-      } else if(WIFCONTINUED(waitStatus)) {
-        printf("continued\n");
-      }
-    } while(!WIFEXITED(waitStatus) && !WIFSIGNALED(waitStatus));
+    return;
   }
+
+  pid_t w;
+  int waitStatus;
+  do {
+    w = waitProcess(process, waitStatus, WUNTRACED | WCONTINUED);
+    if(w==-1) {
+      std::cerr << "Could not wait for process\n";
+      return;
+    }
+    if(WIFEXITED(waitStatus) && waitStatus==0) {
+      std::cout << "python succeed\n";
+    } else if(waitStatus!=0) {
+      std::cerr << "python did not succeed\n";
+      exit(0);
+    } else if(WIFSIGNALED(waitStatus)) {
+      printf("killed by signal %d\n", WTERMSIG(waitStatus));
+    } else if(WIFSTOPPED(waitStatus)) {
+      printf("stopped by signal %d\n", WSTOPSIG(waitStatus));
+    } else if(WIFCONTINUED(waitStatus)) {
+      printf("continued\n");
+    }
+  } while(!WIFEXITED(waitStatus) && !WIFSIGNALED(waitStatus));
 }
 
 bool isNear(float value, float reference) {
@@ -285,6 +440,77 @@ std::vector<float> calculatePMF(std::vector<int> &tracking) {
   // assert(isPMF(probabilities));
   return probabilities;
 }
+
+std::vector<float> quantizePMF(const std::vector<float> &probabilities) {
+  if(gConfig.quantization <= 0. || probabilities.empty()) {
+    return probabilities;
+  }
+
+  std::vector<float> quantized;
+
+  if(gConfig.quantizationMode=="grid") {
+    float sum = 0.;
+    for(auto p : probabilities) {
+      double steps = std::round(p/gConfig.quantization);
+      if(p > 0. && steps==0.) {
+        steps = 1.;
+      }
+      quantized.push_back((float)(steps*gConfig.quantization));
+      sum += quantized.back();
+    }
+
+    for(auto &q : quantized) {
+      q = sum > 0. ? q/sum : 1.f/(float)quantized.size();
+    }
+    return quantized;
+  }
+
+  // simplex lattice, the counts sum up to the resolution
+  int resolution = std::max(1, (int)std::lround(1./gConfig.quantization));
+  std::vector<int> counts;
+  std::vector<double> remainders;
+  int sum = 0;
+  for(auto p : probabilities) {
+    double scaled = p*resolution;
+    int count = (int)std::floor(scaled);
+    if(p > 0. && count==0) {
+      count = 1;
+    }
+    counts.push_back(count);
+    remainders.push_back(scaled - count);
+    sum += count;
+  }
+
+  while(sum < resolution) {
+    auto max = std::max_element(remainders.begin(), remainders.end()) - remainders.begin();
+    counts[max]++;
+    remainders[max] -= 1.;
+    sum++;
+  }
+
+  while(sum > resolution) {
+    auto max = std::max_element(counts.begin(), counts.end()) - counts.begin();
+    if(counts[max] <= 1) {
+      break;
+    }
+    counts[max]--;
+    sum--;
+  }
+
+  for(auto count : counts) {
+    quantized.push_back((float)count/(float)sum);
+  }
+  return quantized;
+}
+
+float getDelta(const std::vector<float> &a, const std::vector<float> &b) {
+  assert(a.size()==b.size());
+  float delta = 0.;
+  for(size_t i = 0; i < a.size(); i++) {
+    delta += std::abs(a[i] - b[i]);
+  }
+  return delta;
+}
 bool fileExist(const std::string &path) {
   struct stat buffer{};
   if(stat(path.c_str(), &buffer)!=0) {
@@ -342,3 +568,19 @@ std::string getTimeString() {
   strftime(buffer, 80, "%Y-%m-%dT%H:%M:%S", localtime(&t));
   return std::string(buffer);
 }
+
+uint64_t hashBytes(const char *data, size_t size, uint64_t hash) {
+  for(size_t i = 0; i < size; i++) {
+    hash ^= (unsigned char)data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+std::string hashString(const std::string &str) {
+  uint64_t hash = hashBytes(str.data(), str.size());
+
+  char buffer[17];
+  snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long)hash);
+  return std::string(buffer);
+}
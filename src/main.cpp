@@ -4,6 +4,10 @@
 
 #include "SUMOConnector.h"
 #include "Simulation.h"
+#include "Strategy.h"
+#include "StrategyCache.h"
+#include "SynthesisBackend.h"
+#include "SynthesisTelemetry.h"
 
 void syncGui(SUMOConnector &sumo1, SUMOConnector &sumo2);
 
@@ -93,6 +97,23 @@ int main(int argc, char *argv[]) {
     delete simulation;
   }
 
+  // the in-memory cache is always on, its statistics are printed with the cache directory or --debug-files
+  if(!gConfig.noStrategyCache && (!gConfig.cacheDir.empty() || gConfig.debugFiles)) {
+    std::cout << "Strategy cache hits : " << StrategyCache::instance().getHits()
+              << " (" << StrategyCache::instance().getDiskHits() << " from disk)"
+              << " - misses : " << StrategyCache::instance().getMisses() << std::endl;
+  }
+  if(gConfig.debugFiles) {
+    std::cout << "Strategy lookup misses : " << Strategy::getTotalMisses()
+              << " (" << Strategy::getTotalUnresolved() << " without action)" << std::endl;
+  }
+  if(!gConfig.telemetryFile.empty()) {
+    SynthesisTelemetry::instance().printSummary(std::cout);
+  }
+  if(gConfig.backend=="auto") {
+    BackendCalibration::instance().printSummary(std::cout);
+  }
+
   return 0;
 }
 
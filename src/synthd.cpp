@@ -0,0 +1,413 @@
+#include <algorithm>
+#include <map>
+#include <deque>
+#include <vector>
+#include <string>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <boost/program_options.hpp>
+
+#include "STORMConnector.h"
+#include "ShieldModelGenerator.h"
+#include "StrategyCache.h"
+#include "SynthesisProtocol.h"
+#include "SynthesisTelemetry.h"
+#include "Util.h"
+
+/**
+ * adaptiveShielding-synthd, synthesis worker of the adaptive shields.
+ *
+ * The worker listens on a Unix socket, every connection carries one synthesis request
+ * (see SynthesisProtocol.h). STORM runs once per distinct model, concurrent requests for the same
+ * model wait for the same job and solved models are answered from the strategy cache.
+ * A client closing its connection cancels its request, jobs without clients get killed.
+ */
+
+/**
+ * Struct SynthdClient. Contains the connection of a client.
+ */
+struct SynthdClient {
+  /// Request line, complete after the newline.
+  std::string request;
+  /// Response line, the connection gets closed after it is written.
+  std::string response;
+  size_t written{0};
+  /// Key of the requested model, empty until the request is complete.
+  std::string modelKey;
+};
+
+/**
+ * Struct SynthdJob. Contains a STORM job and the clients waiting for it.
+ */
+struct SynthdJob {
+  struct STORMJob job;
+  std::vector<int> clients;
+};
+
+static volatile sig_atomic_t running = 1;
+
+static void stop(int) {
+  running = 0;
+}
+
+/// @brief Parse the worker options into the config, exits on invalid options.
+static std::string parseArgs(int argc, char *argv[], struct configInfo &config) {
+  std::string socketPath;
+  try {
+    boost::program_options::options_description desc("Allowed options");
+    desc.add_options()
+        ("socket", boost::program_options::value(&socketPath)->required(), "Unix socket the worker listens on.")
+        ("synthesis-jobs", boost::program_options::value(&config.synthesisJobs),
+            "Max. number of concurrent STORM processes.")
+        ("synthesis-timeout", boost::program_options::value(&config.synthesisTimeout),
+            "Wall clock time limit of a strategy synthesis in seconds.")
+        ("synthesis-memory", boost::program_options::value(&config.synthesisMemory),
+            "Memory limit of a strategy synthesis in MB (0 disables the limit).")
+        ("telemetry", boost::program_options::value(&config.telemetryFile),
+            "Append a JSON line with the measurements of every strategy synthesis to the file.")
+        ("cache-dir", boost::program_options::value(&config.cacheDir),
+            "Directory to share solved strategies between runs.")
+        ("cache-size", boost::program_options::value(&config.cacheDirSize),
+            "Size limit of the cache directory in MB.")
+        ("no-strategy-cache", "Always run STORM, also for models which are already solved.")
+        ("help", "Help message.");
+
+    boost::program_options::variables_map vm;
+    boost::program_options::store(boost::program_options::parse_command_line(argc, argv, desc), vm);
+
+    if(vm.count("help") || argc==1) {
+      std::cout << desc << "\n";
+      exit(1);
+    }
+
+    boost::program_options::notify(vm);
+
+    config.noStrategyCache = vm.count("no-strategy-cache") ? true : false;
+  }
+  catch(std::exception &e) {
+    std::cout << e.what() << "\n";
+    exit(1);
+  }
+
+  if(config.synthesisMemory > 0 && access(PRLIMIT_PATH, X_OK)!=0) {
+    std::cerr << "The synthesis memory limit needs " << PRLIMIT_PATH << " (util-linux)\n";
+    exit(1);
+  }
+
+  if(config.synthesisJobs < 1) {
+    config.synthesisJobs = 1;
+  }
+
+  if(config.synthesisTimeout < 1) {
+    config.synthesisTimeout = 1;
+  }
+
+  return socketPath;
+}
+
+/// @brief Create the listening socket, a stale socket file of an old worker gets replaced.
+static int listenOn(const std::string &socketPath) {
+  struct sockaddr_un address{};
+  if(socketPath.size() >= sizeof(address.sun_path)) {
+    std::cerr << "Socket path " << socketPath << " is too long\n";
+    return -1;
+  }
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+  struct stat info{};
+  if(stat(socketPath.c_str(), &info)==0) {
+    if(!S_ISSOCK(info.st_mode)) {
+      std::cerr << socketPath << " exists and is no socket\n";
+      return -1;
+    }
+    unlink(socketPath.c_str());
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+  if(fd==-1 || bind(fd, (struct sockaddr *)&address, sizeof(address))==-1 || listen(fd, SOMAXCONN)==-1) {
+    perror("Could not listen on the socket");
+    if(fd!=-1) {
+      close(fd);
+    }
+    return -1;
+  }
+  return fd;
+}
+
+/// @brief Queue the response of a client, it gets written by the poll loop.
+static void respond(std::map<int, struct SynthdClient> &clients, int fd, const std::string &response) {
+  auto client = clients.find(fd);
+  if(client!=clients.end()) {
+    client->second.response = response;
+  }
+}
+
+/// @brief Handle a complete request, answer from the cache or wait for a STORM job.
+static void handleRequest(std::map<int, struct SynthdClient> &clients, int fd,
+                          std::map<std::string, struct SynthdJob> &jobs, std::deque<std::string> &pendingJobs) {
+  auto &client = clients[fd];
+  struct STORMModel model;
+  if(!decodeRequest(client.request.substr(0, client.request.find('\n')), model)) {
+    struct SynthesisRecord record;
+    record.outcome = "failed";
+    respond(clients, fd, encodeResponse(record, StrategyTable()));
+    return;
+  }
+
+  // the key addresses the shared cache, a client must not store a strategy under a foreign model
+  ShieldModelGenerator generator;
+  if(!model.properties.empty()) {
+    generator.setProperties(split(model.properties, ";"));
+  }
+  std::string program = model.constants.empty() ? model.prism : model.prism + "// " + model.constants;
+  if(generator.getModelKey(program, model.labels)!=model.key) {
+    std::cerr << "Synthesis request with a wrong model key " << model.key << std::endl;
+    struct SynthesisRecord record;
+    record.outcome = "failed";
+    respond(clients, fd, encodeResponse(record, StrategyTable()));
+    return;
+  }
+  client.modelKey = model.key;
+
+  StrategyTable table;
+  if(!gConfig.noStrategyCache && StrategyCache::instance().lookup(model.key, table)) {
+    struct SynthesisRecord record;
+    record.modelKey = model.key;
+    record.backend = "cache";
+    record.outcome = "success";
+    respond(clients, fd, encodeResponse(record, table));
+    return;
+  }
+
+  // run STORM once per distinct model
+  auto job = jobs.find(model.key);
+  if(job!=jobs.end()) {
+    job->second.clients.push_back(fd);
+    return;
+  }
+
+  auto &synthdJob = jobs[model.key];
+  synthdJob.job.model = std::move(model);
+  synthdJob.clients.push_back(fd);
+  pendingJobs.push_back(synthdJob.job.model.key);
+}
+
+/// @brief Remove a client from the job it waits for, the job gets killed if no client waits any more.
+static void dropClient(std::map<int, struct SynthdClient> &clients, int fd,
+                       std::map<std::string, struct SynthdJob> &jobs, std::deque<std::string> &pendingJobs) {
+  auto client = clients.find(fd);
+  if(client==clients.end()) {
+    return;
+  }
+
+  auto job = jobs.find(client->second.modelKey);
+  if(job!=jobs.end()) {
+    auto &waiting = job->second.clients;
+    waiting.erase(std::remove(waiting.begin(), waiting.end(), fd), waiting.end());
+    if(waiting.empty()) {
+      STORMConnector::killJob(job->second.job);
+      pendingJobs.erase(std::remove(pendingJobs.begin(), pendingJobs.end(), job->first), pendingJobs.end());
+      jobs.erase(job);
+    }
+  }
+
+  close(fd);
+  clients.erase(client);
+}
+
+/// @brief Start queued jobs until the configured number of STORM processes runs.
+static void dispatch(std::map<std::string, struct SynthdJob> &jobs, std::deque<std::string> &pendingJobs,
+                     std::map<int, struct SynthdClient> &clients) {
+  size_t active = 0;
+  for(const auto &job : jobs) {
+    if(job.second.job.pid!=-1) {
+      active++;
+    }
+  }
+
+  while(!pendingJobs.empty() && active < gConfig.synthesisJobs) {
+    std::string modelKey = pendingJobs.front();
+    pendingJobs.pop_front();
+
+    auto &job = jobs[modelKey];
+    if(!STORMConnector::startJob("synthd_" + modelKey, job.job)) {
+      struct SynthesisRecord record;
+      record.modelKey = modelKey;
+      record.outcome = "failed";
+      for(int fd : job.clients) {
+        respond(clients, fd, encodeResponse(record, StrategyTable()));
+      }
+      jobs.erase(modelKey);
+      continue;
+    }
+    active++;
+  }
+}
+
+/// @brief Collect finished jobs and answer their clients.
+static void collect(std::map<std::string, struct SynthdJob> &jobs, std::map<int, struct SynthdClient> &clients) {
+  for(auto job = jobs.begin(); job!=jobs.end();) {
+    if(job->second.job.pid==-1) {
+      job++;
+      continue;
+    }
+
+    std::string filePrefix = "synthd_" + job->first;
+    int waitStatus;
+    pid_t w = STORMConnector::collectJob(filePrefix, job->second.job, waitStatus);
+    if(w==0) {
+      job++;
+      continue;
+    }
+
+    struct SynthesisRecord record;
+    StrategyTable table;
+    if(w!=-1) {
+      STORMConnector::finishJob(filePrefix, job->second.job, waitStatus, record, table);
+      SynthesisTelemetry::instance().record(record);
+    } else {
+      std::cerr << "Could not wait for process\n";
+      STORMConnector::killJob(job->second.job);
+      record.modelKey = job->first;
+      record.outcome = "failed";
+    }
+
+    if(record.outcome=="success" && !gConfig.noStrategyCache) {
+      StrategyCache::instance().insert(job->first, table);
+    }
+
+    std::string response = encodeResponse(record, table);
+    for(int fd : job->second.clients) {
+      respond(clients, fd, response);
+    }
+    job = jobs.erase(job);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  std::string socketPath = parseArgs(argc, argv, gConfig);
+
+  // clients may disconnect before their response is written
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+
+  int listenFd = listenOn(socketPath);
+  if(listenFd==-1) {
+    return 1;
+  }
+  std::cout << "adaptiveShielding-synthd listening on " << socketPath << std::endl;
+
+  std::map<int, struct SynthdClient> clients;
+  std::map<std::string, struct SynthdJob> jobs;
+  std::deque<std::string> pendingJobs;
+
+  while(running) {
+    std::vector<struct pollfd> fds;
+    fds.push_back({listenFd, POLLIN, 0});
+    for(const auto &client : clients) {
+      short events = POLLIN;
+      if(!client.second.response.empty()) {
+        events |= POLLOUT;
+      }
+      fds.push_back({client.first, events, 0});
+    }
+    size_t jobFds = fds.size();
+    for(const auto &job : jobs) {
+      if(job.second.job.pidfd!=-1) {
+        fds.push_back({job.second.job.pidfd, POLLIN, 0});
+      }
+    }
+
+    // without process file descriptors the timeout bounds the latency of finished jobs
+    if(::poll(fds.data(), fds.size(), 100) > 0) {
+      // the exit time of the readable jobs, collected below
+      for(auto &job : jobs) {
+        for(size_t i = jobFds; i < fds.size(); i++) {
+          if(fds[i].fd==job.second.job.pidfd && fds[i].revents!=0) {
+            STORMConnector::stampExit(job.second.job);
+          }
+        }
+      }
+    }
+
+    int fd;
+    while((fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK))!=-1) {
+      clients[fd];
+    }
+
+    std::vector<int> dropped;
+    for(auto &client : clients) {
+      char buffer[1 << 16];
+      ssize_t size;
+      while((size = read(client.first, buffer, sizeof(buffer))) > 0) {
+        if(client.second.modelKey.empty()) {
+          client.second.request.append(buffer, size);
+        }
+        if(client.second.request.size() > SYNTHESIS_MAX_REQUEST) {
+          break;
+        }
+      }
+      bool oversized = client.second.request.size() > SYNTHESIS_MAX_REQUEST
+          && client.second.request.find('\n')==std::string::npos;
+      if(oversized) {
+        std::cerr << "Synthesis request exceeds " << SYNTHESIS_MAX_REQUEST << " bytes\n";
+      }
+      if(oversized || size==0 || (size==-1 && errno!=EAGAIN && errno!=EWOULDBLOCK && errno!=EINTR)) {
+        dropped.push_back(client.first);
+        continue;
+      }
+
+      if(client.second.modelKey.empty() && client.second.response.empty()
+          && client.second.request.find('\n')!=std::string::npos) {
+        handleRequest(clients, client.first, jobs, pendingJobs);
+      }
+    }
+    for(int closed : dropped) {
+      dropClient(clients, closed, jobs, pendingJobs);
+    }
+
+    collect(jobs, clients);
+    dispatch(jobs, pendingJobs, clients);
+
+    dropped.clear();
+    for(auto &client : clients) {
+      auto &response = client.second.response;
+      while(!response.empty() && client.second.written < response.size()) {
+        ssize_t size = write(client.first, response.data() + client.second.written,
+                             response.size() - client.second.written);
+        if(size <= 0) {
+          break;
+        }
+        client.second.written += size;
+      }
+      if(!response.empty() && client.second.written==response.size()) {
+        dropped.push_back(client.first);
+      }
+    }
+    for(int closed : dropped) {
+      // the job of the client is finished, closing only releases the connection
+      clients[closed].modelKey.clear();
+      dropClient(clients, closed, jobs, pendingJobs);
+    }
+  }
+
+  for(auto &job : jobs) {
+    STORMConnector::killJob(job.second.job);
+  }
+  for(const auto &client : clients) {
+    close(client.first);
+  }
+  close(listenFd);
+  unlink(socketPath.c_str());
+
+  return 0;
+}
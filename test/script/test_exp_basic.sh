@@ -22,7 +22,7 @@ SUMO_CFG1=$SOURCE_DIR/data/exp_basic/one_junction.sumo.cfg
 
 SHIELD_BIN=$WORKING_DIR/adaptiveShielding
 
-$SHIELD_BIN -c $SUMO_CFG1 -d 4 - l 0.3 -k 10 -t 6000 -o $TEST_LOG > $TEST_OUT
+$SHIELD_BIN -c $SUMO_CFG1 -d 4 - l 0.3 -k 10 -t 6000 -o $TEST_LOG --debug-files > $TEST_OUT
 if [ $? -ne 0 ]; then
   echo RUN FAIELD
   exit 1
@@ -22,7 +22,7 @@ SUMO_CFG3=$SOURCE_DIR/data/exp_bus/osm.sumocfg
 
 SHIELD_BIN=$WORKING_DIR/adaptiveShielding
 
-$SHIELD_BIN -c $SUMO_CFG3 -w $SOURCE_DIR/data/exp_bus/shieldIDs.txt --bus -d 1 - l 0.3 -k 10 -t 6000 -o $TEST_LOG > $TEST_OUT
+$SHIELD_BIN -c $SUMO_CFG3 -w $SOURCE_DIR/data/exp_bus/shieldIDs.txt --bus -d 1 - l 0.3 -k 10 -t 6000 -o $TEST_LOG --debug-files > $TEST_OUT
 
 if [ $? -ne 0 ]; then
   echo RUN FAIELD
@@ -0,0 +1,66 @@
+#include <boost/test/unit_test.hpp>
+
+#include "MDPSolver.h"
+#include "Environment.h"
+#include "Controller.h"
+#include "Util.h"
+
+namespace {
+/// Restore the solver options changed by a test.
+struct SymmetryFixture {
+  bool symmetryReduction{gConfig.symmetryReduction};
+
+  ~SymmetryFixture() {
+    gConfig.symmetryReduction = symmetryReduction;
+  }
+};
+
+/// Two phases serving two lanes each, the lanes of a phase are interchangeable.
+struct SymmetricJunction {
+  Environment environment{std::vector<std::string>{"J_0", "J_1", "J_2", "J_3"},
+                          std::vector<float>{0.25, 0.25, 0.25, 0.25},
+                          std::vector<int>{1, 1, 1, 1},
+                          std::vector<int>{3, 3, 3, 3}};
+  Controller controller{std::vector<struct phaseInfo>{{0, 0, "GGrr", {"J_0", "J_1"}},
+                                                      {1, 2, "rrGG", {"J_2", "J_3"}}}};
+};
+
+StrategyTable solve(const SymmetricJunction &junction, bool symmetryReduction, size_t &modelStates) {
+  gConfig.symmetryReduction = symmetryReduction;
+  MDPSolver solver;
+  StrategyTable table;
+  BOOST_REQUIRE(solver.solve(junction.environment, junction.controller, table));
+  modelStates = solver.getModelStates();
+  return table;
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(SymmetryReduction, SymmetryFixture)
+
+BOOST_AUTO_TEST_CASE(lanes_of_the_same_ways_form_a_class) {
+  auto classes = MDPSolver::getLaneClasses({3, 3, 3, 3}, {0.25, 0.25, 0.25, 0.25}, {{0, 1}, {2, 3}});
+  BOOST_TEST(classes.size()==2u);
+  BOOST_TEST((classes[0]==std::vector<size_t>{0, 1}));
+  BOOST_TEST((classes[1]==std::vector<size_t>{2, 3}));
+
+  // a different size or probability splits the class
+  BOOST_TEST(MDPSolver::getLaneClasses({3, 2, 3, 3}, {0.25, 0.25, 0.25, 0.25}, {{0, 1}, {2, 3}}).size()==3u);
+  BOOST_TEST(MDPSolver::getLaneClasses({3, 3, 3, 3}, {0.2, 0.3, 0.25, 0.25}, {{0, 1}, {2, 3}}).size()==3u);
+}
+
+BOOST_AUTO_TEST_CASE(quotient_and_full_model_have_the_same_strategy) {
+  SymmetricJunction junction;
+  size_t fullStates = 0;
+  size_t quotientStates = 0;
+  auto full = solve(junction, false, fullStates);
+  auto quotient = solve(junction, true, quotientStates);
+
+  BOOST_TEST(quotientStates < fullStates);
+  BOOST_TEST(full.getStateSpace()==quotient.getStateSpace());
+  BOOST_TEST(full.size()==quotient.size());
+  for(const auto &step : full.getSteps()) {
+    BOOST_TEST(quotient.get(step.state, step.currentAction)==step.nextAction);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,41 @@
+#include <boost/test/unit_test.hpp>
+
+#include "ShieldModelGenerator.h"
+#include "Environment.h"
+#include "Controller.h"
+
+namespace {
+/// Get the model key of a junction with two lanes and two phases.
+std::string getTestModelKey(const std::vector<std::string> &lanes, const std::vector<float> &probabilities) {
+  Environment environment(lanes, probabilities, std::vector<int>(lanes.size(), 1), std::vector<int>{3, 4});
+  Controller controller(std::vector<struct phaseInfo>{{0, 0, "Gr", {lanes[0]}}, {1, 2, "rG", {lanes[1]}}});
+
+  ShieldModelGenerator generator("test");
+  generator.createPRISMArbiter(controller);
+  generator.createPRISMEnvironment(environment);
+  generator.createPRISMController(controller);
+  generator.createPRISMShield(controller);
+  generator.createPRISMRewards(controller);
+  return generator.getModelKey(generator.getPRISMModel(environment, controller), environment.getStateSpaceLabels());
+}
+}
+
+BOOST_AUTO_TEST_SUITE(ModelKey)
+
+BOOST_AUTO_TEST_CASE(equal_models_of_different_junctions_share_the_key) {
+  auto key = getTestModelKey({"J1_0", "J1_1"}, {0.25, 0.75});
+  BOOST_TEST(!key.empty());
+  BOOST_TEST(key==getTestModelKey({"J2_0", "J2_1"}, {0.25, 0.75}));
+}
+
+BOOST_AUTO_TEST_CASE(different_probabilities_result_in_different_keys) {
+  BOOST_TEST(getTestModelKey({"J1_0", "J1_1"}, {0.25, 0.75})!=getTestModelKey({"J1_0", "J1_1"}, {0.5, 0.5}));
+  BOOST_TEST(getTestModelKey({"J1_0", "J1_1"}, {0.25, 0.75})!=getTestModelKey({"J1_0", "J1_1"}, {0.75, 0.25}));
+}
+
+BOOST_AUTO_TEST_CASE(label_prefixes_are_replaced_as_whole_identifiers) {
+  // J1_1 is a prefix of J1_10, the key must not depend on the label names
+  BOOST_TEST(getTestModelKey({"J1_1", "J1_10"}, {0.25, 0.75})==getTestModelKey({"J3_0", "J3_1"}, {0.25, 0.75}));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,453 @@
+#include <boost/test/unit_test.hpp>
+
+#include <sstream>
+#include <cstdint>
+#include <map>
+#include <fstream>
+#include <experimental/filesystem>
+#include <unistd.h>
+
+#include "Strategy.h"
+#include "Util.h"
+
+BOOST_AUTO_TEST_SUITE(ExplicitScheduler)
+
+// two lanes with max. state 1 and two actions, the shield move of state index s is 3*s + 2
+BOOST_AUTO_TEST_CASE(choices_are_parsed_from_labels_and_indices) {
+  Strategy strategy("test", {"a", "b"});
+  std::istringstream sched("Fully defined memoryless deterministic scheduler:\n"
+                           "0 : 0 {env}\n"
+                           "2 : 0 {action1}\n"
+                           "5 : 1\n");
+  BOOST_TEST(strategy.loadExplicitSched(sched, {1, 1}, 2));
+
+  const auto &table = strategy.getStrategyTable();
+  BOOST_TEST(table.size()==2u);
+  BOOST_TEST(table.get({0, 0}, 0)==1);
+  BOOST_TEST(table.get({0, 0}, 1)==1);
+}
+
+BOOST_AUTO_TEST_CASE(malformed_lines_are_skipped_and_reported) {
+  const std::vector<std::string> lines{
+      "2 {action1}\n",      // no separator
+      "2 : {env}\n",        // no digits in the label
+      "2 : \n",             // no choice
+      "2 : 1x\n",           // trailing garbage
+      "2 : 7\n",            // unknown action
+      "99999999999999999999999 : 0\n", // index overflow
+  };
+
+  for(const auto &line : lines) {
+    Strategy strategy("test", {"a", "b"});
+    std::istringstream sched(line + "5 : 1\n");
+    BOOST_TEST(!strategy.loadExplicitSched(sched, {1, 1}, 2), line);
+    BOOST_TEST(strategy.getStrategyTable().size()==1u, line);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+namespace {
+/// Mappings of two lanes with max. state 2 and three actions, next action = (lanes + action) mod 3.
+std::vector<struct StrategyStep> getTestSteps() {
+  std::vector<struct StrategyStep> steps;
+  for(int a = 0; a <= 2; a++) {
+    for(int b = 0; b <= 2; b++) {
+      for(int action = 0; action < 3; action++) {
+        if((a + b + action)%4!=3) {
+          steps.push_back({{a, b}, action, (a + b + action)%3});
+        }
+      }
+    }
+  }
+  return steps;
+}
+}
+
+BOOST_AUTO_TEST_SUITE(Table)
+
+BOOST_AUTO_TEST_CASE(dense_and_sparse_tables_are_equivalent) {
+  StrategyTable dense({2, 2}, 3);
+  // the layout exceeds STRATEGY_TABLE_DENSE_MAX, the table falls back to the hash table
+  StrategyTable sparse({1 << 13, 1 << 13}, 3);
+  for(const auto &step : getTestSteps()) {
+    dense.set(step.state, step.currentAction, step.nextAction);
+    sparse.set(step.state, step.currentAction, step.nextAction);
+  }
+
+  BOOST_TEST(dense.getActionCount()==3);
+  BOOST_TEST(sparse.getActionCount()==0);
+  BOOST_TEST(dense.size()==sparse.size());
+  BOOST_TEST(dense.getStateSpace()==sparse.getStateSpace());
+  for(int a = -1; a <= 3; a++) {
+    for(int b = -1; b <= 3; b++) {
+      for(int action = -1; action <= 3; action++) {
+        BOOST_TEST(dense.get({a, b}, action)==sparse.get({a, b}, action));
+      }
+    }
+  }
+  BOOST_TEST(dense.get({0}, 0)==-1);
+  BOOST_TEST(sparse.get({0}, 0)==-1);
+
+  auto denseSteps = dense.getSteps();
+  auto sparseSteps = sparse.getSteps();
+  BOOST_REQUIRE(denseSteps.size()==sparseSteps.size());
+  for(size_t i = 0; i < denseSteps.size(); i++) {
+    BOOST_TEST(denseSteps[i].state==sparseSteps[i].state);
+    BOOST_TEST(denseSteps[i].currentAction==sparseSteps[i].currentAction);
+    BOOST_TEST(denseSteps[i].nextAction==sparseSteps[i].nextAction);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(growing_the_layout_keeps_the_mappings) {
+  StrategyTable table({1, 1}, 2);
+  table.set({1, 0}, 1, 0);
+  table.set({0, 1}, 0, 1);
+
+  // a lane, an action and a lane again exceed the layout
+  table.set({3, 0}, 0, 1);
+  table.set({0, 0}, 4, 2);
+  table.set({1, 5}, 1, 3);
+
+  BOOST_TEST(table.getBounds()==std::vector<int>({3, 5}));
+  BOOST_TEST(table.getActionCount()==5);
+  BOOST_TEST(table.getStateSpace()==std::vector<int>({3, 5}));
+  BOOST_TEST(table.size()==5u);
+  BOOST_TEST(table.get({1, 0}, 1)==0);
+  BOOST_TEST(table.get({0, 1}, 0)==1);
+  BOOST_TEST(table.get({3, 0}, 0)==1);
+  BOOST_TEST(table.get({0, 0}, 4)==2);
+  BOOST_TEST(table.get({1, 5}, 1)==3);
+  BOOST_TEST(table.get({1, 0}, 0)==-1);
+
+  // overwriting a mapping does not count it twice
+  table.set({1, 0}, 1, 1);
+  BOOST_TEST(table.size()==5u);
+  BOOST_TEST(table.get({1, 0}, 1)==1);
+}
+
+BOOST_AUTO_TEST_CASE(mappings_added_one_by_one_grow_the_layout_geometrically) {
+  StrategyTable table;
+  for(int i = 0; i < 100; i++) {
+    table.set({i}, 0, i%3);
+  }
+
+  // the bounds double, the max. state values are the ones of the mappings
+  BOOST_TEST(table.getBounds()==std::vector<int>({127}));
+  BOOST_TEST(table.getStateSpace()==std::vector<int>({99}));
+  BOOST_TEST(table.size()==100u);
+  for(int i = 0; i < 100; i++) {
+    BOOST_TEST(table.get({i}, 0)==i%3);
+  }
+  BOOST_TEST(table.get({100}, 0)==-1);
+  BOOST_TEST(table.getSteps().size()==100u);
+}
+
+BOOST_AUTO_TEST_CASE(actions_beyond_the_entry_range_fall_back_to_the_hash_table) {
+  StrategyTable table({1}, 1);
+  table.set({0}, 0, 1);
+
+  // the dense entries hold the next action + 1
+  table.set({1}, 0, UINT16_MAX - 1);
+  BOOST_TEST(table.getActionCount()==1);
+  BOOST_TEST(table.get({1}, 0)==UINT16_MAX - 1);
+
+  table.set({1}, 0, UINT16_MAX);
+  BOOST_TEST(table.getActionCount()==0);
+  BOOST_TEST(table.get({1}, 0)==UINT16_MAX);
+  BOOST_TEST(table.get({0}, 0)==1);
+  BOOST_TEST(table.size()==2u);
+
+  // negative values have no dense index
+  StrategyTable negative({1}, 1);
+  negative.set({0}, 0, 0);
+  negative.set({-1}, 0, 0);
+  BOOST_TEST(negative.getActionCount()==0);
+  BOOST_TEST(negative.get({-1}, 0)==0);
+  BOOST_TEST(negative.get({0}, 0)==0);
+}
+
+BOOST_AUTO_TEST_CASE(steps_are_in_lexicographic_order) {
+  auto steps = getTestSteps();
+  std::vector<struct StrategyStep> shuffled(steps.rbegin(), steps.rend());
+  std::swap(shuffled[1], shuffled[shuffled.size()/2]);
+
+  for(const auto &table : {StrategyTable(shuffled), StrategyTable(std::vector<struct StrategyStep>{})}) {
+    auto tableSteps = table.getSteps();
+    BOOST_TEST(tableSteps.size()==table.size());
+    for(size_t i = 1; i < tableSteps.size(); i++) {
+      const auto &previous = tableSteps[i - 1];
+      const auto &step = tableSteps[i];
+      BOOST_TEST((previous.state < step.state
+          || (previous.state==step.state && previous.currentAction < step.currentAction)));
+    }
+  }
+
+  StrategyTable sparse({1 << 13, 1 << 13}, 3);
+  for(const auto &step : shuffled) {
+    sparse.set(step.state, step.currentAction, step.nextAction);
+  }
+  auto sparseSteps = sparse.getSteps();
+  BOOST_REQUIRE(sparseSteps.size()==steps.size());
+  for(size_t i = 0; i < steps.size(); i++) {
+    BOOST_TEST(sparseSteps[i].state==steps[i].state);
+    BOOST_TEST(sparseSteps[i].currentAction==steps[i].currentAction);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+namespace {
+/// A strategy with holes, state s and action a have a mapping if the pattern hash of (s, a) is not 0 mod holes.
+struct FallbackCase {
+  const char *name;
+  std::vector<int> stateSpace;
+  int actionCount;
+  int holes;
+  /// Force the hash table, the fallbacks are resolved per lookup.
+  bool sparse;
+};
+
+const std::vector<struct FallbackCase> FALLBACK_CASES{
+    {"two lanes, few holes", {3, 3}, 2, 5, false},
+    {"two lanes, many holes", {3, 3}, 2, 2, false},
+    {"three lanes", {2, 1, 3}, 3, 3, false},
+    {"single lane", {6}, 2, 3, false},
+    {"two lanes, hash table", {3, 3}, 2, 3, true},
+};
+
+/// The per-lookup search: the mapping of the state or of the first lane decremented by one with a mapping.
+int getReferenceAction(const std::map<std::pair<std::vector<int>, int>, int> &mappings,
+                       const std::vector<int> &state, int currentAction) {
+  if(std::all_of(state.begin(), state.end(), [](int i) { return i==0; })) {
+    return -1;
+  }
+
+  auto mapping = mappings.find({state, currentAction});
+  if(mapping!=mappings.end()) {
+    return mapping->second;
+  }
+  for(size_t i = 0; i < state.size(); i++) {
+    if(state[i]!=0) {
+      auto testState = state;
+      testState[i]--;
+      mapping = mappings.find({testState, currentAction});
+      if(mapping!=mappings.end()) {
+        return mapping->second;
+      }
+    }
+  }
+  return -1;
+}
+
+/// Visit all states of a box, the lanes range from -1 to the state space + 1.
+template<class F>
+void forEachState(const std::vector<int> &stateSpace, F f) {
+  std::vector<int> state(stateSpace.size(), -1);
+  for(bool done = false; !done;) {
+    f(state);
+    done = true;
+    for(size_t lane = state.size(); lane-- > 0;) {
+      if(++state[lane] <= stateSpace[lane] + 1) {
+        done = false;
+        break;
+      }
+      state[lane] = -1;
+    }
+  }
+}
+}
+
+BOOST_AUTO_TEST_SUITE(Fallback)
+
+BOOST_AUTO_TEST_CASE(remembered_fallbacks_match_the_lookup_search) {
+  for(const auto &fallbackCase : FALLBACK_CASES) {
+    BOOST_TEST_CONTEXT(fallbackCase.name) {
+      std::vector<std::string> labels(fallbackCase.stateSpace.size(), "lane");
+      std::map<std::pair<std::vector<int>, int>, int> mappings;
+      StrategyTable table;
+      if(fallbackCase.sparse) {
+        table = StrategyTable(std::vector<int>(fallbackCase.stateSpace.size(), 1 << 13), fallbackCase.actionCount);
+      }
+      // the lookup strategy gets the mappings step by step, the other one the whole table
+      Strategy lookup("test", labels);
+
+      forEachState(fallbackCase.stateSpace, [&](const std::vector<int> &state) {
+        for(int action = 0; action < fallbackCase.actionCount; action++) {
+          int hash = action + 1;
+          for(auto i : state) {
+            hash = hash*7 + i;
+          }
+          bool inside = std::all_of(state.begin(), state.end(), [](int i) { return i >= 0; });
+          for(size_t i = 0; i < state.size(); i++) {
+            inside = inside && state[i] <= fallbackCase.stateSpace[i];
+          }
+          if(inside && hash%fallbackCase.holes!=0) {
+            int nextAction = hash%fallbackCase.actionCount;
+            mappings[{state, action}] = nextAction;
+            table.set(state, action, nextAction);
+            lookup.addStrategyStep(state, action, nextAction);
+          }
+        }
+      });
+      BOOST_TEST((table.getActionCount()==0)==fallbackCase.sparse);
+
+      Strategy remembered("test", labels);
+      remembered.setStrategyTable(table);
+
+      // the second pass gets the remembered fallbacks
+      for(int pass = 0; pass < 2; pass++) {
+        forEachState(fallbackCase.stateSpace, [&](const std::vector<int> &state) {
+          for(int action = -1; action <= fallbackCase.actionCount; action++) {
+            int expected = getReferenceAction(mappings, state, action);
+            BOOST_TEST(remembered.getStrategyAction(state, action)==expected);
+            BOOST_TEST(lookup.getStrategyAction(state, action)==expected);
+          }
+        });
+      }
+      BOOST_TEST(remembered.getMisses()==lookup.getMisses());
+      BOOST_TEST(remembered.getUnresolved()==lookup.getUnresolved());
+      BOOST_TEST(remembered.getMisses() > remembered.getUnresolved());
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+namespace {
+/// A binary strategy file in the temp directory, removed after the test.
+struct BinaryFileFixture {
+  std::string filename{(std::experimental::filesystem::temp_directory_path()
+      / ("StrategyTest_" + std::to_string(getpid()) + ".bstrat")).string()};
+  const std::vector<std::string> labels{"J_0", "J_1"};
+
+  ~BinaryFileFixture() {
+    std::remove(filename.c_str());
+  }
+
+  void write(const StrategyTable &table) const {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    Strategy::writeBinaryStrategyTable(out, table, labels);
+  }
+
+  std::string read() const {
+    std::ifstream in(filename, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+
+  void overwrite(const std::string &data) const {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), (std::streamsize)data.size());
+  }
+
+  /// Replace the checksum at the end of the file by the checksum of the content.
+  static void resign(std::string &data) {
+    uint64_t checksum = hashBytes(data.data(), data.size() - sizeof(checksum));
+    data.replace(data.size() - sizeof(checksum), sizeof(checksum), (const char *)&checksum, sizeof(checksum));
+  }
+
+  /// Load the file into a table with a mapping, a rejected file must leave the table unchanged.
+  bool load() const {
+    StrategyTable table;
+    table.set({1}, 0, 0);
+    std::vector<std::string> loadedLabels;
+    bool loaded = Strategy::loadBinaryStrategyTable(filename, table, loadedLabels);
+    if(!loaded) {
+      BOOST_TEST(table.size()==1u);
+      BOOST_TEST(table.get({1}, 0)==0);
+    }
+    return loaded;
+  }
+};
+
+void checkRoundTrip(const BinaryFileFixture &file, const StrategyTable &table) {
+  file.write(table);
+
+  StrategyTable loaded;
+  std::vector<std::string> labels;
+  BOOST_REQUIRE(Strategy::loadBinaryStrategyTable(file.filename, loaded, labels));
+  BOOST_TEST(labels==file.labels);
+  // the rows of a sparse table are loaded into a layout fitted to the mappings
+  if(table.getActionCount() > 0) {
+    BOOST_TEST(loaded.getActionCount()==table.getActionCount());
+    BOOST_TEST(loaded.getBounds()==table.getBounds());
+  }
+  BOOST_TEST(loaded.getStateSpace()==table.getStateSpace());
+  BOOST_TEST(loaded.size()==table.size());
+
+  auto steps = table.getSteps();
+  auto loadedSteps = loaded.getSteps();
+  BOOST_REQUIRE(loadedSteps.size()==steps.size());
+  for(size_t i = 0; i < steps.size(); i++) {
+    BOOST_TEST(loadedSteps[i].state==steps[i].state);
+    BOOST_TEST(loadedSteps[i].currentAction==steps[i].currentAction);
+    BOOST_TEST(loadedSteps[i].nextAction==steps[i].nextAction);
+  }
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(BinaryFormat, BinaryFileFixture)
+
+BOOST_AUTO_TEST_CASE(dense_and_sparse_tables_round_trip) {
+  checkRoundTrip(*this, StrategyTable(getTestSteps()));
+
+  StrategyTable sparse({1 << 13, 1 << 13}, 3);
+  for(const auto &step : getTestSteps()) {
+    sparse.set(step.state, step.currentAction, step.nextAction);
+  }
+  BOOST_REQUIRE(sparse.getActionCount()==0);
+  checkRoundTrip(*this, sparse);
+
+  checkRoundTrip(*this, StrategyTable());
+}
+
+BOOST_AUTO_TEST_CASE(a_flipped_bit_is_rejected) {
+  write(StrategyTable(getTestSteps()));
+  auto data = read();
+  BOOST_REQUIRE(load());
+
+  // a entry, a label and the checksum itself
+  for(size_t position : {data.size() - sizeof(uint64_t) - 1, sizeof(uint64_t)*4 + 1, data.size() - 1}) {
+    auto corrupt = data;
+    corrupt[position] ^= 0x10;
+    overwrite(corrupt);
+    BOOST_TEST(!load(), position);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(a_truncated_file_is_rejected) {
+  write(StrategyTable(getTestSteps()));
+  auto data = read();
+
+  for(size_t size : {data.size() - 1, data.size() - sizeof(uint64_t), data.size()/2, (size_t)8, (size_t)0}) {
+    overwrite(data.substr(0, size));
+    BOOST_TEST(!load(), size);
+  }
+
+  // a valid checksum does not make a short payload valid
+  auto truncated = data.substr(0, data.size() - sizeof(uint64_t) - sizeof(uint16_t));
+  truncated.append(sizeof(uint64_t), '\0');
+  resign(truncated);
+  overwrite(truncated);
+  BOOST_TEST(!load());
+}
+
+BOOST_AUTO_TEST_CASE(a_different_version_is_rejected) {
+  write(StrategyTable(getTestSteps()));
+  auto data = read();
+
+  // the version follows the magic, the file is signed again to only test the version check
+  uint32_t version = STRATEGY_BINARY_VERSION + 1;
+  data.replace(4, sizeof(version), (const char *)&version, sizeof(version));
+  resign(data);
+  overwrite(data);
+  BOOST_TEST(!load());
+
+  version = STRATEGY_BINARY_VERSION;
+  data.replace(4, sizeof(version), (const char *)&version, sizeof(version));
+  resign(data);
+  overwrite(data);
+  BOOST_TEST(load());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,100 @@
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+
+#include "Util.h"
+
+namespace {
+/// Restores the quantization settings of gConfig.
+struct QuantizationFixture {
+  double quantization{gConfig.quantization};
+  std::string quantizationMode{gConfig.quantizationMode};
+
+  ~QuantizationFixture() {
+    gConfig.quantization = quantization;
+    gConfig.quantizationMode = quantizationMode;
+  }
+};
+
+const std::vector<std::vector<float>> PMFS{
+    {0.25, 0.75},
+    {0.1, 0.2, 0.3, 0.4},
+    {0.333, 0.333, 0.334},
+    {0.01, 0.02, 0.97},
+    {0.0, 0.5, 0.5},
+    {0.123, 0.456, 0.211, 0.21},
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(QuantizePMF, QuantizationFixture)
+
+BOOST_AUTO_TEST_CASE(without_quantization_the_input_is_returned) {
+  gConfig.quantization = 0.;
+  for(const auto &pmf : PMFS) {
+    BOOST_TEST(quantizePMF(pmf)==pmf);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(lattice_is_a_pmf_on_the_resolution) {
+  gConfig.quantizationMode = "lattice";
+  for(double step : {0.05, 0.1, 0.125, 0.25}) {
+    gConfig.quantization = step;
+    int resolution = (int)std::lround(1./step);
+    for(const auto &pmf : PMFS) {
+      auto quantized = quantizePMF(pmf);
+      BOOST_TEST_REQUIRE(quantized.size()==pmf.size());
+      BOOST_TEST(std::accumulate(quantized.begin(), quantized.end(), 0.)==1., boost::test_tools::tolerance(1e-5));
+
+      // positive probabilities below the step keep one step at the expense of the others
+      bool raised = std::any_of(pmf.begin(), pmf.end(), [step](float p) { return p > 0. && p < step; });
+      for(size_t i = 0; i < pmf.size(); i++) {
+        double counts = quantized[i]*resolution;
+        BOOST_TEST(std::abs(counts - std::round(counts)) < 1e-4);
+        BOOST_TEST((quantized[i] > 0.)==(pmf[i] > 0.));
+        if(!raised) {
+          BOOST_TEST(std::abs(quantized[i] - pmf[i]) < step);
+        }
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(lattice_with_more_lanes_than_steps_is_a_pmf) {
+  gConfig.quantizationMode = "lattice";
+  gConfig.quantization = 0.5;
+  auto quantized = quantizePMF({0.1, 0.2, 0.3, 0.4});
+  BOOST_TEST(std::accumulate(quantized.begin(), quantized.end(), 0.)==1., boost::test_tools::tolerance(1e-5));
+}
+
+BOOST_AUTO_TEST_CASE(grid_is_a_pmf) {
+  gConfig.quantizationMode = "grid";
+  for(double step : {0.05, 0.1, 0.25}) {
+    gConfig.quantization = step;
+    for(const auto &pmf : PMFS) {
+      auto quantized = quantizePMF(pmf);
+      BOOST_TEST_REQUIRE(quantized.size()==pmf.size());
+      BOOST_TEST(std::accumulate(quantized.begin(), quantized.end(), 0.)==1., boost::test_tools::tolerance(1e-5));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(grid_keeps_positive_probabilities) {
+  gConfig.quantizationMode = "grid";
+  gConfig.quantization = 0.1;
+  for(const auto &pmf : PMFS) {
+    auto quantized = quantizePMF(pmf);
+    for(size_t i = 0; i < pmf.size(); i++) {
+      BOOST_TEST((quantized[i] > 0.)==(pmf[i] > 0.));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(close_pmfs_share_the_quantization) {
+  gConfig.quantizationMode = "lattice";
+  gConfig.quantization = 0.1;
+  BOOST_TEST(quantizePMF({0.31, 0.69})==quantizePMF({0.29, 0.71}));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
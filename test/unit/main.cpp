@@ -0,0 +1,3 @@
+#define BOOST_TEST_MODULE adaptiveShielding
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>